@@ -98,17 +98,22 @@ PRESTOCLIENT_FIELD* new_prestofield()
 
 	field->name       = NULL;
 	field->type       = PRESTOCLIENT_TYPE_VARCHAR;
+	field->servertype = NULL;
 	field->datasize   = 1024 * sizeof(char);
 	field->data       = (char*)malloc(field->datasize + 1);
+	field->datalength = 0;
 	field->dataisnull = false;
+	field->dataisstring = false;
 
 	if (!field->data)
 		exit(1);
 
+	field->data[0] = 0;
+
 	return field;
 }
 
-static PRESTOCLIENT_RESULT* new_prestoresult()
+PRESTOCLIENT_RESULT* new_prestoresult()
 {
 	PRESTOCLIENT_RESULT* result = (PRESTOCLIENT_RESULT*)malloc( sizeof(PRESTOCLIENT_RESULT) );
 
@@ -117,14 +122,16 @@ static PRESTOCLIENT_RESULT* new_prestoresult()
 
 	result->client                 = NULL;
 	result->hcurl                  = NULL;
+	result->hmulti                 = NULL;
 	result->curl_error_buffer      = NULL;
 	result->lastinfouri            = NULL;
 	result->lastnexturi            = NULL;
 	result->lastcanceluri          = NULL;
 	result->laststate              = NULL;
 	result->lasterrormessage       = NULL;
+	result->lastservermessage      = NULL;
 	result->clientstatus           = PRESTOCLIENT_STATUS_NONE;
-	result->cancelquery            = false;
+	result->cancelevent            = util_new_event();
 	result->lastresponse           = NULL;
 	result->lastresponsebuffersize = 0;
 	result->lastresponseactualsize = 0;
@@ -138,6 +145,14 @@ static PRESTOCLIENT_RESULT* new_prestoresult()
 	result->json                   = NULL;
 	result->lexer                  = NULL;
 
+	result->write_callback_function    = NULL;
+	result->describe_callback_function = NULL;
+	result->progress_callback_function = NULL;
+	result->client_object              = NULL;
+
+	memset(&result->stats, 0, sizeof(PRESTOCLIENT_STATS) );
+	memset(&result->serverstats, 0, sizeof(PRESTOCLIENT_SERVERSTATS) );
+
 	return result;
 }
 
@@ -157,6 +172,8 @@ static PRESTOCLIENT* new_prestoclient()
 	client->language       = NULL;
 	client->results        = NULL;
 	client->active_results = 0;
+	client->resultslock    = util_new_mutex();
+	client->progress_callback_function = NULL;
 
 	return client;
 }
@@ -169,6 +186,9 @@ static void delete_prestofield(PRESTOCLIENT_FIELD* field)
 	if (field->name)
 		free(field->name);
 
+	if (field->servertype)
+		free(field->servertype);
+
 	if (field->data)
 		free(field->data);
 
@@ -188,6 +208,8 @@ static void register_result(PRESTOCLIENT_RESULT* result)
 
 	client = result->client;
 
+	util_lock(client->resultslock);
+
 	client->active_results++;
 
 	if (client->active_results == 1)
@@ -199,16 +221,21 @@ static void register_result(PRESTOCLIENT_RESULT* result)
 		exit(1);
 
 	client->results[client->active_results - 1] = result;
+
+	util_unlock(client->resultslock);
 }
 
 // Delete this result set from memory and remove from PRESTOCLIENT
-static void delete_prestoresult(PRESTOCLIENT_RESULT* result)
+void delete_prestoresult(PRESTOCLIENT_RESULT* result)
 {
 	unsigned int i;
 
 	if (!result)
 		return;
 
+	if (result->hmulti)
+		curl_multi_cleanup(result->hmulti);
+
 	if (result->hcurl)
 	{
 		curl_easy_cleanup(result->hcurl);
@@ -236,6 +263,9 @@ static void delete_prestoresult(PRESTOCLIENT_RESULT* result)
 	if (result->lasterrormessage)
 		free(result->lasterrormessage);
 
+	if (result->lastservermessage)
+		free(result->lastservermessage);
+
 	if (result->lastresponse)
 		free(result->lastresponse);
 
@@ -245,6 +275,8 @@ static void delete_prestoresult(PRESTOCLIENT_RESULT* result)
 	if (result->columns)
 		free(result->columns);
 
+	util_delete_event(result->cancelevent);
+
 	free(result);
 }
 
@@ -267,11 +299,115 @@ static void add_headerline(struct curl_slist **header, char *name, char *value)
 	free(line);
 }
 
+// Sleep and add the time to the statistics. Ends early when the query is cancelled
+static void wait_msec(PRESTOCLIENT_RESULT *result, const int sleeptime_msec)
+{
+	double starttime = util_gettime();
+	TRACE_DECLARE(tracestart);
+
+	TRACE_BEGIN(tracestart);
+
+	util_wait_event(result->cancelevent, sleeptime_msec);
+
+	result->stats.waittime += util_gettime() - starttime;
+
+	TRACE_END(tracestart, "wait", "msec", sleeptime_msec);
+}
+
+// Add the curl timings of the last request to the statistics. Returns the total time of the request
+static double add_request_stats(PRESTOCLIENT_RESULT *result, CURL *hcurl, enum E_HTTP_REQUEST_TYPES request_type)
+{
+	double namelookuptime = 0.0, connecttime = 0.0, firstbytetime = 0.0, totaltime = 0.0;
+
+	curl_easy_getinfo(hcurl, CURLINFO_NAMELOOKUP_TIME,     &namelookuptime);
+	curl_easy_getinfo(hcurl, CURLINFO_CONNECT_TIME,        &connecttime);
+	curl_easy_getinfo(hcurl, CURLINFO_STARTTRANSFER_TIME,  &firstbytetime);
+	curl_easy_getinfo(hcurl, CURLINFO_TOTAL_TIME,          &totaltime);
+
+	result->stats.requests++;
+	result->stats.namelookuptime += namelookuptime;
+	result->stats.connecttime    += connecttime;
+	result->stats.firstbytetime  += firstbytetime;
+
+	if (request_type == PRESTOCLIENT_HTTP_REQUEST_TYPE_POST)
+		result->stats.posttime += totaltime;
+	else if (request_type == PRESTOCLIENT_HTTP_REQUEST_TYPE_GET)
+	{
+		result->stats.gettime += totaltime;
+
+		if (totaltime > result->stats.maxgettime)
+			result->stats.maxgettime = totaltime;
+	}
+
+	return totaltime;
+}
+
+// Execute the request. Unlike curl_easy_perform this returns within PRESTOCLIENT_CANCELPOLLMSEC when the query
+// is cancelled, also when the server is slow to respond.
+// The cancel request itself is sent while the query is already cancelled. It is not waited for: this returns
+// as soon as the request was sent, or after PRESTOCLIENT_CANCELTIMEOUTMSEC. The server handles the request
+// when it has received it, a slow answer would only delay the return of prestoclient_query
+static CURLcode perform(PRESTOCLIENT_RESULT *result, CURL *hcurl, enum E_HTTP_REQUEST_TYPES request_type)
+{
+	CURLcode curlstatus = CURLE_ABORTED_BY_CALLBACK;
+	CURLMsg *message;
+	int running = 1, messages;
+	long requestsize = 0;
+	double deadline = util_gettime() + PRESTOCLIENT_CANCELTIMEOUTMSEC / 1000.0;
+
+	if (!result->hmulti)
+	{
+		result->hmulti = curl_multi_init();
+
+		if (!result->hmulti)
+			return CURLE_OUT_OF_MEMORY;
+	}
+
+	curl_multi_add_handle(result->hmulti, hcurl);
+
+	if (request_type == PRESTOCLIENT_HTTP_REQUEST_TYPE_DELETE)
+	{
+		while (running && requestsize == 0 && util_gettime() < deadline)
+		{
+			if (curl_multi_perform(result->hmulti, &running) != CURLM_OK)
+				break;
+
+			// Number of bytes of the request that were sent, zero until the complete request was sent
+			curl_easy_getinfo(hcurl, CURLINFO_REQUEST_SIZE, &requestsize);
+
+			if (running && requestsize == 0)
+				curl_multi_wait(result->hmulti, NULL, 0, PRESTOCLIENT_CANCELPOLLMSEC, NULL);
+		}
+	}
+	else
+	{
+		while (running && !util_isset_event(result->cancelevent))
+		{
+			if (curl_multi_perform(result->hmulti, &running) != CURLM_OK)
+				break;
+
+			if (running)
+				curl_multi_wait(result->hmulti, NULL, 0, PRESTOCLIENT_CANCELPOLLMSEC, NULL);
+		}
+	}
+
+	while ( (message = curl_multi_info_read(result->hmulti, &messages) ) )
+	{
+		if (message->msg == CURLMSG_DONE && message->easy_handle == hcurl)
+			curlstatus = message->data.result;
+	}
+
+	curl_multi_remove_handle(result->hmulti, hcurl);
+
+	return curlstatus;
+}
+
 // Callback function for CURL data. Data is added to the resultset databuffer
-static size_t WriteCallback(void *contents, size_t size, size_t nmemb, void *userp)
+size_t WriteCallback(void *contents, size_t size, size_t nmemb, void *userp)
 {
 	size_t contentsize = size * nmemb;
 	PRESTOCLIENT_RESULT	*result = (PRESTOCLIENT_RESULT*)userp;
+	double starttime, callbacktime;
 
 	// Do we need a bigger buffer ? Should not happen
 	if (result->lastresponseactualsize + contentsize > result->lastresponsebuffersize)
@@ -289,16 +425,23 @@ static size_t WriteCallback(void *contents, size_t size, size_t nmemb, void *use
 
 	// Update actual size
 	result->lastresponseactualsize += contentsize;
+	result->stats.bytes += contentsize;
 
 	// Add terminating zero
 	result->lastresponse[result->lastresponseactualsize] = 0;
 
 	// Start/continue parsing json. Stop on errors
+	// Time spent in callback functions is measured separately and not counted as parse time
+	starttime    = util_gettime();
+	callbacktime = result->stats.callbacktime;
+
 	if (!json_reader(result) )
 		return 0;
 
+	result->stats.parsetime += util_gettime() - starttime - (result->stats.callbacktime - callbacktime);
+
 	// Return number of bytes processed or zero if the query should be cancelled
-	return (result->cancelquery ? 0 : contentsize);
+	return (util_isset_event(result->cancelevent) ? 0 : contentsize);
 }
 
 // Send a http request to the Presto server. in_uri is emptied
@@ -324,6 +467,8 @@ static unsigned int openuri(enum E_HTTP_REQUEST_TYPES in_request_type,
 	bool retry;
 	unsigned int retrycount, length;
 	long http_code, expected_http_code, expected_http_code_busy;
+	double requesttime;
+	TRACE_DECLARE(tracestart);
 
 	uasource   = PRESTOCLIENT_SOURCE;
 	query_url  = PRESTOCLIENT_QUERY_URL;
@@ -383,7 +528,8 @@ static unsigned int openuri(enum E_HTTP_REQUEST_TYPES in_request_type,
 		*in_uri[0] = 0;
 	}
 
-	// CURL options
+	// CURL options. Without NOSIGNAL curl uses signals for the connect timeout, which is not safe with threads
+	curl_easy_setopt(hcurl, CURLOPT_NOSIGNAL, (long)1 );
 	curl_easy_setopt(hcurl, CURLOPT_CONNECTTIMEOUT_MS, (long)PRESTOCLIENT_URLTIMEOUT );
 
 	switch (in_request_type)
@@ -392,7 +538,7 @@ static unsigned int openuri(enum E_HTTP_REQUEST_TYPES in_request_type,
 		{
 			expected_http_code = PRESTOCLIENT_CURL_EXPECT_HTTP_GET_POST;
 			curl_easy_setopt(hcurl, CURLOPT_POST, (long)1 );
-			curl_easy_setopt(hcurl, CURLOPT_BUFFERSIZE, (long)(in_buffersize - 1) );
+			curl_easy_setopt(hcurl, CURLOPT_BUFFERSIZE, (long)*in_buffersize );
 			break;
 		}
 
@@ -400,7 +546,6 @@ static unsigned int openuri(enum E_HTTP_REQUEST_TYPES in_request_type,
 		{
 			expected_http_code = PRESTOCLIENT_CURL_EXPECT_HTTP_GET_POST;
 			curl_easy_setopt(hcurl, CURLOPT_HTTPGET, (long)1 );
-			curl_easy_setopt(hcurl, CURLOPT_BUFFERSIZE, (long)(in_buffersize - 1) );
 			break;
 		}
 
@@ -449,7 +594,16 @@ static unsigned int openuri(enum E_HTTP_REQUEST_TYPES in_request_type,
 		retrycount++;
 
 		// Execute request
-		curlstatus = curl_easy_perform(hcurl);
+		TRACE_BEGIN(tracestart);
+
+		curlstatus = perform(result, hcurl, in_request_type);
+
+		TRACE_END(tracestart,
+				  in_request_type == PRESTOCLIENT_HTTP_REQUEST_TYPE_GET  ? "http get"  :
+				  in_request_type == PRESTOCLIENT_HTTP_REQUEST_TYPE_POST ? "http post" : "http delete",
+				  "attempt", retrycount);
+
+		requesttime = add_request_stats(result, hcurl, in_request_type);
 
 		if (curlstatus == CURLE_OK)
 		{
@@ -457,14 +611,39 @@ static unsigned int openuri(enum E_HTTP_REQUEST_TYPES in_request_type,
 			http_code = 0;
 			curl_easy_getinfo(hcurl, CURLINFO_RESPONSE_CODE, &http_code);
 
+			metrics_add_request(in_request_type, requesttime,
+								http_code == expected_http_code_busy,
+								http_code != expected_http_code && http_code != expected_http_code_busy,
+								false);
+
 			if (http_code == expected_http_code)
 			{
 				retry  = false;
+
+				if (in_request_type != PRESTOCLIENT_HTTP_REQUEST_TYPE_DELETE)
+					result->stats.pages++;
 			}
 			else if (http_code == expected_http_code_busy)
 			{
-				// Server is busy
-				util_sleep(PRESTOCLIENT_RETRYWAITTIMEMSEC * retrycount);
+				// Server is busy. Don't retry a cancelled query, this includes the cancel request itself
+				if (util_isset_event(result->cancelevent) )
+				{
+					if (in_request_type != PRESTOCLIENT_HTTP_REQUEST_TYPE_DELETE)
+						result->errorcode = PRESTOCLIENT_RESULT_CANCELLED;
+
+					retry = false;
+				}
+				else
+				{
+					result->stats.retries++;
+					wait_msec(result, PRESTOCLIENT_RETRYWAITTIMEMSEC * retrycount);
+
+					if (util_isset_event(result->cancelevent) && in_request_type != PRESTOCLIENT_HTTP_REQUEST_TYPE_DELETE)
+					{
+						result->errorcode = PRESTOCLIENT_RESULT_CANCELLED;
+						retry = false;
+					}
+				}
 			}
 			else
 			{
@@ -483,6 +662,13 @@ static unsigned int openuri(enum E_HTTP_REQUEST_TYPES in_request_type,
 		}
 		else
 		{
+			// A transfer the client stopped because the query was cancelled is not an error of the server.
+			// This includes the cancel request, which is not waited for
+			if (util_isset_event(result->cancelevent) )
+				metrics_add_request(in_request_type, requesttime, false, false, true);
+			else
+				metrics_add_request(in_request_type, requesttime, false, true, false);
+
 			result->errorcode = PRESTOCLIENT_RESULT_CURL_ERROR;
 			retry = false;
 		}
@@ -494,6 +680,24 @@ static unsigned int openuri(enum E_HTTP_REQUEST_TYPES in_request_type,
 	return result->errorcode;
 }
 
+// Tell the client a response was handled
+static void call_progress_callback(PRESTOCLIENT_RESULT *result)
+{
+	double starttime;
+	TRACE_DECLARE(tracestart);
+
+	if (!result->progress_callback_function)
+		return;
+
+	starttime = util_gettime();
+	TRACE_BEGIN(tracestart);
+
+	result->progress_callback_function(result->client_object, (void*)result);
+
+	result->stats.callbacktime += util_gettime() - starttime;
+	TRACE_END(tracestart, "progress callback", NULL, 0);
+}
+
 // Send a cancel request to the Prestoserver
 static void cancel(PRESTOCLIENT_RESULT *result)
 {
@@ -515,6 +719,23 @@ static void cancel(PRESTOCLIENT_RESULT *result)
 					NULL,
 					(void*)result);
 	}
+
+	result->errorcode    = PRESTOCLIENT_RESULT_CANCELLED;
+	result->clientstatus = PRESTOCLIENT_STATUS_FAILED;
+}
+
+// Determine the client state from the last response
+static void update_clientstatus(PRESTOCLIENT_RESULT *result)
+{
+	if (result->lastnexturi && strlen(result->lastnexturi) > 0)
+		result->clientstatus = PRESTOCLIENT_STATUS_RUNNING;
+	else
+	{
+		if (result->lasterrormessage && strlen(result->lasterrormessage) > 0)
+			result->clientstatus = PRESTOCLIENT_STATUS_FAILED;
+		else
+			result->clientstatus = PRESTOCLIENT_STATUS_SUCCEEDED;
+	}
 }
 
 // Fetch the next uri from the prestoserver, handle the response and determine if we're done or not
@@ -525,7 +746,7 @@ static bool prestoclient_queryisrunning(PRESTOCLIENT_RESULT *result)
 	if (!result)
 		return false;
 
-	if (result->cancelquery)
+	if (util_isset_event(result->cancelevent))
 	{
 		cancel(result);
 		return false;
@@ -555,16 +776,7 @@ static bool prestoclient_queryisrunning(PRESTOCLIENT_RESULT *result)
 					NULL,
 					(void*)result) == PRESTOCLIENT_RESULT_OK)
 	{
-		// Determine client state
-		if (result->lastnexturi && strlen(result->lastnexturi) > 0)
-			result->clientstatus = PRESTOCLIENT_STATUS_RUNNING;
-		else
-		{
-			if (result->lasterrormessage && strlen(result->lasterrormessage) > 0)
-				result->clientstatus = PRESTOCLIENT_STATUS_FAILED;
-			else
-				result->clientstatus = PRESTOCLIENT_STATUS_SUCCEEDED;
-		}
+		update_clientstatus(result);
 
 		// Update columninfoavailable flag
 		if (result->columncount > 0 && !result->columninfoavailable)
@@ -576,14 +788,28 @@ static bool prestoclient_queryisrunning(PRESTOCLIENT_RESULT *result)
 			result->columninfoprinted = true;
 
 			if (result->describe_callback_function)
+			{
+				double starttime = util_gettime();
+				TRACE_DECLARE(tracestart);
+
+				TRACE_BEGIN(tracestart);
 				result->describe_callback_function(result->client_object, (void*)result);
+				result->stats.callbacktime += util_gettime() - starttime;
+				TRACE_END(tracestart, "describe callback", NULL, 0);
+			}
 		}
 
 		// Clear lexer data for next run
 		json_reset_lexer(result->lexer);
+
+		call_progress_callback(result);
 	}
 	else
 	{
+		// Curl stops the transfer when a callback function asked to cancel
+		if (util_isset_event(result->cancelevent))
+			cancel(result);
+
 		return false;
 	}
 	
@@ -593,21 +819,40 @@ static bool prestoclient_queryisrunning(PRESTOCLIENT_RESULT *result)
 	return true;
 }
 
-// Start fetching packets until we're done. Wait for a specified interval between requests
+// Start fetching packets until we're done. The wait between requests adapts to the progress of the query:
+// no wait after a response with rows, a short wait after the state changed, and while nothing changes a wait
+// that doubles from PRESTOCLIENT_RETRIEVEWAITTIMEMSEC up to PRESTOCLIENT_UPDATEWAITTIMEMSEC
 static void prestoclient_waituntilfinished(PRESTOCLIENT_RESULT *result)
 {
+	unsigned long long rows = result->stats.rows;
+	char *state = NULL;
+	int waittime = PRESTOCLIENT_RETRIEVEWAITTIMEMSEC;
+
+	if (result->laststate)
+		alloc_copy(&state, result->laststate);
+
 	while( prestoclient_queryisrunning(result) )
 	{
-		// Once there is data use the short wait interval
-		if (result->dataavailable)
+		if (result->stats.rows != rows)
+		{
+			rows     = result->stats.rows;
+			waittime = PRESTOCLIENT_RETRIEVEWAITTIMEMSEC;
+		}
+		else if (result->laststate && (!state || strcmp(state, result->laststate) != 0) )
 		{
-			util_sleep(PRESTOCLIENT_RETRIEVEWAITTIMEMSEC);
+			alloc_copy(&state, result->laststate);
+			waittime = PRESTOCLIENT_RETRIEVEWAITTIMEMSEC;
+			wait_msec(result, waittime);
 		}
 		else
 		{
-			util_sleep(PRESTOCLIENT_UPDATEWAITTIMEMSEC);
+			wait_msec(result, waittime);
+			waittime = waittime * 2 < PRESTOCLIENT_UPDATEWAITTIMEMSEC ? waittime * 2 : PRESTOCLIENT_UPDATEWAITTIMEMSEC;
 		}
 	}
+
+	if (state)
+		free(state);
 }
 
 /* --- Public functions ----------------------------------------------------------------------------------------------- */
@@ -632,6 +877,8 @@ PRESTOCLIENT* prestoclient_init(const char *in_server, const unsigned int *in_po
 	
 	if (in_server && strlen(in_server) > 0)
 	{
+		util_curl_global_init();
+
 		client = new_prestoclient();
 
 		length = (strlen(uasource) + strlen(uaversion) + 2) * sizeof(char);
@@ -703,6 +950,8 @@ void prestoclient_close(PRESTOCLIENT *prestoclient)
 			free(prestoclient->results);
 		}
 
+		util_delete_mutex(prestoclient->resultslock);
+
 		free(prestoclient);
 		prestoclient = NULL;
 	}
@@ -716,6 +965,7 @@ PRESTOCLIENT_RESULT* prestoclient_query(PRESTOCLIENT *prestoclient, const char *
 	PRESTOCLIENT_RESULT *result = NULL;
 	char *uasource, *defschema, *query_url;
 	unsigned long buffersize;
+	double starttime;
 
 	uasource   = PRESTOCLIENT_SOURCE;
 	defschema  = PRESTOCLIENT_DEFAULT_SCHEMA;
@@ -735,6 +985,8 @@ PRESTOCLIENT_RESULT* prestoclient_query(PRESTOCLIENT *prestoclient, const char *
 
 		result->client_object = in_client_object;
 
+		result->progress_callback_function = prestoclient->progress_callback_function;
+
 		result->hcurl = curl_easy_init();
 
 		if (!result->hcurl)
@@ -753,6 +1005,9 @@ PRESTOCLIENT_RESULT* prestoclient_query(PRESTOCLIENT *prestoclient, const char *
 		// Add resultset to the client
 		register_result(result);
 
+		starttime = util_gettime();
+		metrics_start_query();
+
 		// Create request
 		if (openuri(PRESTOCLIENT_HTTP_REQUEST_TYPE_POST,
 					result->hcurl,
@@ -769,9 +1024,17 @@ PRESTOCLIENT_RESULT* prestoclient_query(PRESTOCLIENT *prestoclient, const char *
 					&buffersize,
 					(void*)result) == PRESTOCLIENT_RESULT_OK)
 		{
+			// The server may already reject the query in its answer to the POST
+			update_clientstatus(result);
+			call_progress_callback(result);
+
 			// Start polling server for data
 			prestoclient_waituntilfinished(result);
 		}
+		else if (util_isset_event(result->cancelevent))
+			cancel(result);
+
+		metrics_end_query(result, util_gettime() - starttime);
 	}
 
 	return result;
@@ -801,6 +1064,14 @@ char* prestoclient_getlastservererror(PRESTOCLIENT_RESULT *result)
 	return result->lasterrormessage;
 }
 
+char* prestoclient_getlastservermessage(PRESTOCLIENT_RESULT *result)
+{
+	if (!result)
+		return NULL;
+
+	return result->lastservermessage;
+}
+
 unsigned int prestoclient_getcolumncount(PRESTOCLIENT_RESULT *result)
 {
 	if (!result)
@@ -831,6 +1102,17 @@ unsigned int prestoclient_getcolumntype(PRESTOCLIENT_RESULT *result, const unsig
 	return result->columns[columnindex]->type;
 }
 
+char* prestoclient_getcolumnservertype(PRESTOCLIENT_RESULT *result, const unsigned int columnindex)
+{
+	if (!result)
+		return NULL;
+
+	if (columnindex >= result->columncount)
+		return NULL;
+
+	return (result->columns[columnindex]->servertype ? result->columns[columnindex]->servertype : "");
+}
+
 char* prestoclient_getcolumntypedescription(PRESTOCLIENT_RESULT *result, const unsigned int columnindex)
 {
 	if (!result)
@@ -926,6 +1208,28 @@ char* prestoclient_getcolumndata(PRESTOCLIENT_RESULT *result, const unsigned int
 	return result->columns[columnindex]->data;
 }
 
+unsigned int prestoclient_getcolumndatalength(PRESTOCLIENT_RESULT *result, const unsigned int columnindex)
+{
+	if (!result || !result->columns)
+		return 0;
+
+	if (columnindex >= result->columncount)
+		return 0;
+
+	return result->columns[columnindex]->datalength;
+}
+
+int prestoclient_getcolumndataisstring(PRESTOCLIENT_RESULT *result, const unsigned int columnindex)
+{
+	if (!result || !result->columns)
+		return false;
+
+	if (columnindex >= result->columncount)
+		return false;
+
+	return result->columns[columnindex]->dataisstring ? true : false;
+}
+
 int prestoclient_getnullcolumnvalue(PRESTOCLIENT_RESULT *result, const unsigned int columnindex)
 {
 	if (!result || !result->columns)
@@ -940,7 +1244,23 @@ int prestoclient_getnullcolumnvalue(PRESTOCLIENT_RESULT *result, const unsigned
 void prestoclient_cancelquery(PRESTOCLIENT_RESULT *result)
 {
 	if (result)
-		result->cancelquery = true;
+		util_set_event(result->cancelevent);
+}
+
+void prestoclient_cancelqueries(PRESTOCLIENT *prestoclient)
+{
+	unsigned int i;
+
+	if (!prestoclient)
+		return;
+
+	// A result is registered before its first request is sent. A finished query doesn't look at its event anymore
+	util_lock(prestoclient->resultslock);
+
+	for (i = 0; i < prestoclient->active_results; i++)
+		util_set_event(prestoclient->results[i]->cancelevent);
+
+	util_unlock(prestoclient->resultslock);
 }
 
 char* prestoclient_getlastclienterror(PRESTOCLIENT_RESULT *result)
@@ -962,6 +1282,8 @@ char* prestoclient_getlastclienterror(PRESTOCLIENT_RESULT *result)
 			return "CURL error occurred";
 		case PRESTOCLIENT_RESULT_PARSE_JSON_ERROR:
 			return "Error parsing returned json object";
+		case PRESTOCLIENT_RESULT_CANCELLED:
+			return "Query was cancelled";
 		default:
 			return "Invalid errorcode";
 	}
@@ -979,4 +1301,66 @@ char* prestoclient_getlastcurlerror(PRESTOCLIENT_RESULT *result)
 		return NULL;
 
 	return (result->curl_error_buffer ? result->curl_error_buffer : "");
+}
+
+int prestoclient_getstats(PRESTOCLIENT_RESULT *result, PRESTOCLIENT_STATS *stats)
+{
+	if (!result || !stats)
+		return false;
+
+	memcpy(stats, &result->stats, sizeof(PRESTOCLIENT_STATS) );
+
+	return true;
+}
+
+int prestoclient_getserverstats(PRESTOCLIENT_RESULT *result, PRESTOCLIENT_SERVERSTATS *stats)
+{
+	if (!result || !stats)
+		return false;
+
+	memcpy(stats, &result->serverstats, sizeof(PRESTOCLIENT_SERVERSTATS) );
+
+	return true;
+}
+
+void prestoclient_setprogresscallback(PRESTOCLIENT *prestoclient, void (*in_progress_callback_function)(void*, void*) )
+{
+	if (prestoclient)
+		prestoclient->progress_callback_function = in_progress_callback_function;
+}
+
+double prestoclient_getprogress(PRESTOCLIENT_RESULT *result)
+{
+	if (!result)
+		return -1.0;
+
+	if (result->clientstatus == PRESTOCLIENT_STATUS_SUCCEEDED)
+		return 100.0;
+
+	if (result->serverstats.totalsplits == 0)
+		return -1.0;
+
+	return 100.0 * (double)result->serverstats.completedsplits / (double)result->serverstats.totalsplits;
+}
+
+double prestoclient_getestimatedtimeleft(PRESTOCLIENT_RESULT *result)
+{
+	PRESTOCLIENT_SERVERSTATS	*stats;
+	double						 runningtime;
+
+	if (!result)
+		return -1.0;
+
+	if (result->clientstatus == PRESTOCLIENT_STATUS_SUCCEEDED)
+		return 0.0;
+
+	stats = &result->serverstats;
+
+	if (stats->totalsplits == 0 || stats->completedsplits == 0 || stats->elapsedtimemillis < stats->queuedtimemillis)
+		return -1.0;
+
+	// Assume the remaining splits take as long as the completed ones did
+	runningtime = (double)(stats->elapsedtimemillis - stats->queuedtimemillis) / 1000.0;
+
+	return runningtime * (double)(stats->totalsplits - stats->completedsplits) / (double)stats->completedsplits;
 }
\ No newline at end of file
@@ -36,12 +36,30 @@ extern "C" {
 #endif
 
 /* --- Defines -------------------------------------------------------------------------------------------------------- */
+/**
+ * \brief Marks the functions exported by the prestoclient shared library
+ *        Define PRESTOCLIENT_SHARED when using the Windows DLL. Other functions of the library are hidden.
+ */
+#if defined(_WIN32) && defined(PRESTOCLIENT_SHARED)
+  #ifdef PRESTOCLIENT_BUILD
+    #define PRESTOCLIENT_API __declspec(dllexport)
+  #else
+    #define PRESTOCLIENT_API __declspec(dllimport)
+  #endif
+#elif defined(__GNUC__) && __GNUC__ >= 4
+  #define PRESTOCLIENT_API __attribute__ ((visibility ("default") ) )
+#else
+  #define PRESTOCLIENT_API
+#endif
+
 #define PRESTOCLIENT_SOURCE              "cPrestoClient"  /**< Client name sent to Presto server */
 #define PRESTOCLIENT_VERSION             "0.3.1"          /**< PrestoClient version string */
 #define PRESTOCLIENT_URLTIMEOUT           5000            /**< Timeout in millisec to wait for Presto server to respond */
-#define PRESTOCLIENT_UPDATEWAITTIMEMSEC   1500            /**< Wait time in millisec to wait between requests to Presto server */
-#define PRESTOCLIENT_RETRIEVEWAITTIMEMSEC 50              /**< Wait time in millisec to wait before getting next data packet */
+#define PRESTOCLIENT_UPDATEWAITTIMEMSEC   1500            /**< Maximum wait time in millisec between requests while the query makes no progress */
+#define PRESTOCLIENT_RETRIEVEWAITTIMEMSEC 50              /**< Wait time in millisec between requests after the state of the query changed */
 #define PRESTOCLIENT_RETRYWAITTIMEMSEC    100             /**< Wait time in millisec to wait before retrying a request */
+#define PRESTOCLIENT_CANCELPOLLMSEC       10              /**< Maximum time in millisec a running request takes to notice a cancel */
+#define PRESTOCLIENT_CANCELTIMEOUTMSEC    100             /**< Maximum time in millisec to wait until a cancel request was sent */
 #define PRESTOCLIENT_MAXIMUMRETRIES       5               /**< Maximum number of retries for request in case of 503 errors */
 #define PRESTOCLIENT_DEFAULT_PORT         8080            /**< Default tcp port of presto server */
 #define PRESTOCLIENT_DEFAULT_CATALOG      "hive"          /**< Default presto catalog name */
@@ -82,6 +100,18 @@ enum E_CLIENTSTATUS
     PRESTOCLIENT_STATUS_FAILED
 };
 
+/**
+ * \brief How the values of a column are stored in a PRESTOCLIENT_BATCH
+ */
+enum E_BATCHTYPES
+{
+	PRESTOCLIENT_BATCH_TEXT = 0,	/**< Text of all values, each followed by a zero byte, and offsets of the values. Values of
+										 array, map and row columns are compact json text */
+	PRESTOCLIENT_BATCH_BIGINT,		/**< Array of long long, 0 for null values */
+	PRESTOCLIENT_BATCH_DOUBLE,		/**< Array of double, 0.0 for null values */
+	PRESTOCLIENT_BATCH_BOOLEAN		/**< Array of char, 1 for true, 0 for false and null values */
+};
+
 /* --- Structs -------------------------------------------------------------------------------------------------------- */
 /**
  * \brief  Query resultset used to interface with prestoclient. All members are private.
@@ -93,16 +123,70 @@ typedef struct ST_PRESTOCLIENT_RESULT PRESTOCLIENT_RESULT;
  */
 typedef struct ST_PRESTOCLIENT        PRESTOCLIENT;
 
+/**
+ * \brief  Rows of a query stored per column, see prestoclient_batch_new. All members are private.
+ */
+typedef struct ST_PRESTOCLIENT_BATCH  PRESTOCLIENT_BATCH;
+
+/**
+ * \brief  Counters and timings describing the transfer of a query, see prestoclient_getstats
+ *
+ * Times are in seconds. The curl timings are summed over all requests, compare them with
+ * parsetime and callbacktime to see if a query is slow because of the server, the network or the client.
+ */
+typedef struct ST_PRESTOCLIENT_STATS
+{
+	unsigned long long	rows;			/**< Number of rows received */
+	unsigned long long	bytes;			/**< Number of bytes received from the server (http body only) */
+	unsigned long long	pages;			/**< Number of responses received from the server */
+	unsigned long long	cells;			/**< Number of values received (rows times columns) */
+	unsigned long long	requests;		/**< Number of http requests sent, including retries */
+	unsigned long long	retries;		/**< Number of requests repeated because the server was busy (http 503) */
+	double				posttime;		/**< Time of the POST request that started the query */
+	double				gettime;		/**< Time of all GET requests for the next pages */
+	double				maxgettime;		/**< Time of the slowest GET request */
+	double				namelookuptime;	/**< Time spent resolving the server name (CURLINFO_NAMELOOKUP_TIME) */
+	double				connecttime;	/**< Time until connected, including name lookup (CURLINFO_CONNECT_TIME) */
+	double				firstbytetime;	/**< Time until the first byte of each response arrived (CURLINFO_STARTTRANSFER_TIME) */
+	double				parsetime;		/**< Time spent parsing json, without the callback functions */
+	double				callbacktime;	/**< Time spent in the describe and write callback functions */
+	double				waittime;		/**< Time spent waiting between requests */
+} PRESTOCLIENT_STATS;
+
+/**
+ * \brief  Query statistics as reported by the Presto server in the last response, see prestoclient_getserverstats
+ */
+typedef struct ST_PRESTOCLIENT_SERVERSTATS
+{
+	int					scheduled;			/**< True (1) if the query has been scheduled */
+	unsigned long long	nodes;				/**< Number of nodes working on the query */
+	unsigned long long	totalsplits;		/**< Total number of splits */
+	unsigned long long	queuedsplits;		/**< Number of splits waiting to be processed */
+	unsigned long long	runningsplits;		/**< Number of splits being processed */
+	unsigned long long	completedsplits;	/**< Number of splits finished */
+	unsigned long long	usertimemillis;		/**< User time used on all nodes */
+	unsigned long long	cputimemillis;		/**< Cpu time used on all nodes */
+	unsigned long long	walltimemillis;		/**< Wall time used on all nodes */
+	unsigned long long	queuedtimemillis;	/**< Time the query was queued */
+	unsigned long long	elapsedtimemillis;	/**< Time since the query was submitted */
+	unsigned long long	processedrows;		/**< Number of rows read from the source */
+	unsigned long long	processedbytes;		/**< Number of bytes read from the source */
+	unsigned long long	peakmemorybytes;	/**< Peak memory used by the query */
+} PRESTOCLIENT_SERVERSTATS;
+
 /* --- Functions ------------------------------------------------------------------------------------------------------ */
 /**
  * \brief               Get the version string of prestoclient
  *
  * \return              Null terminated version string
  */
+PRESTOCLIENT_API
 char*                   prestoclient_getversion();
 
 /**
  * \brief               Initiate a client connection
+ *                      The settings of the client don't change after this call, so one client may be shared
+ *                      by several threads that run queries at the same time. Also initializes libcurl (once).
  *
  * \param in_server     String contaning the servername or address. Should be without the port number. Not NULL
  * \param in_port       Unsigned int containing the tcp port of the Presto server. May be NULL
@@ -114,6 +198,7 @@ char*                   prestoclient_getversion();
  *
  * \return              A handle to the PRESTOCLIENT object if successful or NULL if init failed
  */
+PRESTOCLIENT_API
 PRESTOCLIENT*           prestoclient_init                       ( const char *in_server
                                                                 , const unsigned int *in_port
                                                                 , const char *in_catalog
@@ -125,16 +210,19 @@ PRESTOCLIENT*           prestoclient_init                       ( const char *in
 /**
  * \brief               Close client connection
  *                      Close client connection and delete all used memory. Handle to object is NULL after
- *                      calling this function.
+ *                      calling this function. Only call this when no thread is running a query with this client.
  *
  * \param prestoclient  Handle to PRESTOCLIENT object
  */
+PRESTOCLIENT_API
 void                    prestoclient_close                      (PRESTOCLIENT *prestoclient);
 
 /**
  * \brief               Execute a query
  *                      Executes a query and calls callback functions when columninfo or data
- *                      is available.
+ *                      is available. Several threads may call this at the same time with the same client, every
+ *                      query has its own connection and parser. Callback functions are called in the thread
+ *                      that started the query.
  *
  * \param prestoclient                  Handle to PRESTOCLIENT object
  * \param in_sql_statement              String containing the sql statement that should be executed on the Presto server
@@ -145,6 +233,7 @@ void                    prestoclient_close                      (PRESTOCLIENT *p
  *
  * \return              A handle to the PRESTOCLIENT_RESULT object if successful or NULL if starting the query failed
  */
+PRESTOCLIENT_API
 PRESTOCLIENT_RESULT*    prestoclient_query                      (PRESTOCLIENT *prestoclient
                                                                 , const char *in_sql_statement
                                                                 , const char *in_schema
@@ -161,6 +250,7 @@ PRESTOCLIENT_RESULT*    prestoclient_query                      (PRESTOCLIENT *p
  *
  * \return              Numeric value corresponding to enum E_CLIENTSTATUS
  */
+PRESTOCLIENT_API
 unsigned int            prestoclient_getstatus                  (PRESTOCLIENT_RESULT *result);
 
 /**
@@ -170,6 +260,7 @@ unsigned int            prestoclient_getstatus                  (PRESTOCLIENT_RE
  *
  * \return              Null terminated string
  */
+PRESTOCLIENT_API
 char*                   prestoclient_getlastserverstate         (PRESTOCLIENT_RESULT *result);
 
 /**
@@ -179,6 +270,7 @@ char*                   prestoclient_getlastserverstate         (PRESTOCLIENT_RE
 *
  * \return              Number of columns or zero if the resultset doesn't contain columninformation (yet)
  */
+PRESTOCLIENT_API
 unsigned int            prestoclient_getcolumncount             (PRESTOCLIENT_RESULT *result);
 
 /**
@@ -189,6 +281,7 @@ unsigned int            prestoclient_getcolumncount             (PRESTOCLIENT_RE
  *
  * \return              Null terminated string
  */
+PRESTOCLIENT_API
 char*                   prestoclient_getcolumnname              (PRESTOCLIENT_RESULT *result, const unsigned int columnindex);
 
 /**
@@ -199,6 +292,7 @@ char*                   prestoclient_getcolumnname              (PRESTOCLIENT_RE
  *
  * \return              Numeric value corresponding to enum E_FIELDTYPES
  */
+PRESTOCLIENT_API
 unsigned int            prestoclient_getcolumntype              (PRESTOCLIENT_RESULT *result, const unsigned int columnindex);
 
 /**
@@ -209,18 +303,60 @@ unsigned int            prestoclient_getcolumntype              (PRESTOCLIENT_RE
  *
  * \return              Null terminated string
  */
+PRESTOCLIENT_API
 char*                   prestoclient_getcolumntypedescription   (PRESTOCLIENT_RESULT *result, const unsigned int columnindex);
 
+/**
+ * \brief               Return the column type of the specified column as sent by the Presto server
+ *                      Unlike prestoclient_getcolumntypedescription this includes the parameters of a type, for example
+ *                      varchar(10), decimal(10,2) or array(bigint). Json escape sequences are not translated.
+ *
+ * \param result        A handle to a PRESTOCLIENT_RESULT object
+ * \param columnindex   Zero based index of column. Should be smaller than number returned by prestoclient_getcolumncount
+ *
+ * \return              Null terminated string
+ */
+PRESTOCLIENT_API
+char*                   prestoclient_getcolumnservertype        (PRESTOCLIENT_RESULT *result, const unsigned int columnindex);
+
 /**
  * \brief               Return the content of the specified column for the current row as string
+ *                      Strings are returned as sent by the server, json escape sequences are not translated.
+ *                      Booleans are returned as "1" or "0". Values of array, map and row columns are
+ *                      returned as compact json text.
  *
  * \param result        A handle to a PRESTOCLIENT_RESULT object
  * \param columnindex   Zero based index of column. Should be smaller than number returned by prestoclient_getcolumncount
  *
  * \return              Null terminated string
  */
+PRESTOCLIENT_API
 char*                   prestoclient_getcolumndata              (PRESTOCLIENT_RESULT *result, const unsigned int columnindex);
 
+/**
+ * \brief               Return the length of the content of the specified column for the current row
+ *
+ * \param result        A handle to a PRESTOCLIENT_RESULT object
+ * \param columnindex   Zero based index of column. Should be smaller than number returned by prestoclient_getcolumncount
+ *
+ * \return              Length in bytes of the string returned by prestoclient_getcolumndata
+ */
+PRESTOCLIENT_API
+unsigned int            prestoclient_getcolumndatalength        (PRESTOCLIENT_RESULT *result, const unsigned int columnindex);
+
+/**
+ * \brief               Returns true if the content of the specified column was sent as a json string by the server
+ *                      Numbers and booleans are sent without quotes, but special values like NaN are sent as strings.
+ *                      Use this function when passing data through as json.
+ *
+ * \param result        A handle to a PRESTOCLIENT_RESULT object
+ * \param columnindex   Zero based index of column. Should be smaller than number returned by prestoclient_getcolumncount
+ *
+ * \return              Return true (1) if the value was a json string, otherwise false (0)
+ */
+PRESTOCLIENT_API
+int                     prestoclient_getcolumndataisstring      (PRESTOCLIENT_RESULT *result, const unsigned int columnindex);
+
 /**
  * \brief               Returns true if the content of the specified column is NULL according to the database
  *
@@ -229,18 +365,37 @@ char*                   prestoclient_getcolumndata              (PRESTOCLIENT_RE
  *
  * \return              Return true (1) if the content of the specified column is NULL, otherwise false (0)
  */
+PRESTOCLIENT_API
 int                     prestoclient_getnullcolumnvalue         (PRESTOCLIENT_RESULT *result, const unsigned int columnindex);
 
 /**
  * \brief               Inform prestoclient to cancel the running query
- *                      Prestoclient should cancel the running query. As soon as prestoclient detects this signal and is not
- *                      in the middle of handling a curl response, it will send a cancel query request to the Presto server
- *                      and return from the prestoclient_query function.
+ *                      Prestoclient should cancel the running query. A running http request is aborted within
+ *                      PRESTOCLIENT_CANCELPOLLMSEC milliseconds and a wait between requests ends immediately. Then
+ *                      prestoclient sends a cancel query request to the Presto server, without waiting for its
+ *                      answer (at most PRESTOCLIENT_CANCELTIMEOUTMSEC milliseconds until it was sent), and returns
+ *                      from the prestoclient_query function. The status of the query will be failed.
+ *                      May be called from any of the callback functions, for example to stop a query that takes too long,
+ *                      or from another thread, using the handle passed to a callback function.
  *
  * \param result        A handle to a PRESTOCLIENT_RESULT object
  */
+PRESTOCLIENT_API
 void                    prestoclient_cancelquery                (PRESTOCLIENT_RESULT *result);
 
+/**
+ * \brief               Inform prestoclient to cancel every running query of the client
+ *                      Same as prestoclient_cancelquery for all queries of the client, including a query whose
+ *                      handle is not known yet because the server has not answered the request that starts it.
+ *                      That request is aborted and prestoclient_query returns with status failed. The server may
+ *                      have started the query, it can't be sent a cancel request without its answer.
+ *                      May be called from another thread. Queries that have finished are not affected.
+ *
+ * \param prestoclient  A handle to a PRESTOCLIENT object
+ */
+PRESTOCLIENT_API
+void                    prestoclient_cancelqueries              (PRESTOCLIENT *prestoclient);
+
 /**
  * \brief               Return error message of last executed request generated by the prestoserver
  *
@@ -248,8 +403,20 @@ void                    prestoclient_cancelquery                (PRESTOCLIENT_RE
  *
  * \return              Error message generated by the prestoserver or NULL if there is no error
  */
+PRESTOCLIENT_API
 char*                   prestoclient_getlastservererror         (PRESTOCLIENT_RESULT *result);
 
+/**
+ * \brief               Return the message of the last error generated by the prestoserver, without the exception type
+ *                      that prestoclient_getlastservererror starts with. Json escape sequences are not translated.
+ *
+ * \param result        A handle to a PRESTOCLIENT_RESULT object
+ *
+ * \return              Error message generated by the prestoserver or NULL if there is no error
+ */
+PRESTOCLIENT_API
+char*                   prestoclient_getlastservermessage       (PRESTOCLIENT_RESULT *result);
+
 /**
  * \brief               Returns description of last error of determined by prestoclient
  *
@@ -257,6 +424,7 @@ char*                   prestoclient_getlastservererror         (PRESTOCLIENT_RE
  *
  * \return              Null terminated string or NULL if no errors occurred
  */
+PRESTOCLIENT_API
 char*                   prestoclient_getlastclienterror         (PRESTOCLIENT_RESULT *result);
 
 /**
@@ -266,8 +434,228 @@ char*                   prestoclient_getlastclienterror         (PRESTOCLIENT_RE
  *
  * \return              Null terminated string, may be empty
  */
+PRESTOCLIENT_API
 char*                   prestoclient_getlastcurlerror           (PRESTOCLIENT_RESULT *result);
 
+/**
+ * \brief               Return statistics of the transfer of a query
+ *                      May be called while the query is running (from a callback function) or after it finished.
+ *
+ * \param result        A handle to a PRESTOCLIENT_RESULT object
+ * \param stats         Pointer to a PRESTOCLIENT_STATS struct that will be filled
+ *
+ * \return              Return true (1) if stats were filled, otherwise false (0)
+ */
+PRESTOCLIENT_API
+int                     prestoclient_getstats                   (PRESTOCLIENT_RESULT *result, PRESTOCLIENT_STATS *stats);
+
+/**
+ * \brief               Return the query statistics sent by the Presto server in its last response
+ *                      These are updated with every response. Use the progress callback function to be notified.
+ *
+ * \param result        A handle to a PRESTOCLIENT_RESULT object
+ * \param stats         Pointer to a PRESTOCLIENT_SERVERSTATS struct that will be filled
+ *
+ * \return              Return true (1) if stats were filled, otherwise false (0)
+ */
+PRESTOCLIENT_API
+int                     prestoclient_getserverstats             (PRESTOCLIENT_RESULT *result, PRESTOCLIENT_SERVERSTATS *stats);
+
+/**
+ * \brief               Set a function that is called after every response of the Presto server
+ *                      Also while the query is queued or running without returning data. Use prestoclient_getserverstats
+ *                      and prestoclient_getlastserverstate to show progress, or prestoclient_cancelquery to stop the query.
+ *                      Applies to queries started after calling this function. Set it before the client is
+ *                      shared with other threads.
+ *
+ * \param prestoclient                  Handle to PRESTOCLIENT object
+ * \param in_progress_callback_function Pointer to function called after every response or NULL. Called with the
+ *                                      client object passed to prestoclient_query and the PRESTOCLIENT_RESULT handle
+ */
+PRESTOCLIENT_API
+void                    prestoclient_setprogresscallback        (PRESTOCLIENT *prestoclient
+                                                                , void (*in_progress_callback_function)(void*, void*)
+                                                                );
+
+/**
+ * \brief               Return the progress of the query as a percentage of the splits completed on the server
+ *
+ * \param result        A handle to a PRESTOCLIENT_RESULT object
+ *
+ * \return              Percentage between 0 and 100 or -1 if not known yet
+ */
+PRESTOCLIENT_API
+double                  prestoclient_getprogress                (PRESTOCLIENT_RESULT *result);
+
+/**
+ * \brief               Return an estimate of the time needed to finish the query
+ *                      Assumes the remaining splits will take as long as the completed splits did.
+ *
+ * \param result        A handle to a PRESTOCLIENT_RESULT object
+ *
+ * \return              Number of seconds or -1 if no estimate can be made yet
+ */
+PRESTOCLIENT_API
+double                  prestoclient_getestimatedtimeleft       (PRESTOCLIENT_RESULT *result);
+
+/**
+ * \brief               Switch recording of trace events on or off
+ *                      Trace points around http requests, json parsing and callback functions record their start
+ *                      time and duration in a ring buffer per thread. Only available when prestoclient was built with
+ *                      PRESTOCLIENT_TRACE defined, otherwise the trace points are not compiled in.
+ *
+ * \param enabled       True (1) to start recording, false (0) to stop
+ *
+ * \return              Return true (1) if tracing is available, otherwise false (0)
+ */
+PRESTOCLIENT_API
+int                     prestoclient_settrace                   (int enabled);
+
+/**
+ * \brief               Write the recorded trace events to a file in Chrome trace-event json format
+ *                      Open the file in chrome://tracing or https://ui.perfetto.dev. Call this when no queries are
+ *                      running, events recorded while writing may be incomplete.
+ *
+ * \param filename      Name of the file to write
+ *
+ * \return              Return true (1) if the file was written, otherwise false (0)
+ */
+PRESTOCLIENT_API
+int                     prestoclient_writetrace                 (const char *filename);
+
+/**
+ * \brief               Return the metrics of all queries run by this process in the Prometheus text format
+ *                      Counts queries by status, http requests, 503 busy responses, errors, cancelled requests, rows
+ *                      and bytes, and has histograms of query and request durations. Rows and bytes are added when a
+ *                      query finishes. All counters are read at once, so the text is consistent: for example totals
+ *                      equal the sum of their histogram buckets. May be called from any thread, for example by the
+ *                      http handler of a Prometheus scrape.
+ *
+ * \param buffer        Buffer for the text. May be NULL to get the needed size
+ * \param buffersize    Size of buffer. The text is truncated and null terminated when it doesn't fit
+ *
+ * \return              Length of the complete text, excluding the terminating zero. Like snprintf: when this is
+ *                      not less than buffersize the text was truncated. Call again with a buffer of at least the
+ *                      returned length + 1. Counters may change in between, so repeat until the text fits
+ */
+PRESTOCLIENT_API
+unsigned int            prestoclient_getmetrics                 (char *buffer, unsigned int buffersize);
+
+/**
+ * \brief               Create a batch that collects rows per column
+ *                      Meant for bindings from other languages, that can copy a column at once instead of calling a
+ *                      function for every value. Pass prestoclient_batch_writecallback as write callback function and
+ *                      the batch as client object to prestoclient_query. Read the batch in the progress callback
+ *                      function, which is called after every response, and clear it afterwards. A batch can be used
+ *                      for one query.
+ *
+ * \return              A handle to the batch, free it with prestoclient_batch_delete
+ */
+PRESTOCLIENT_API
+PRESTOCLIENT_BATCH*     prestoclient_batch_new                  ();
+
+/**
+ * \brief               Free the batch and all its data
+ *
+ * \param batch         A handle to a PRESTOCLIENT_BATCH object
+ */
+PRESTOCLIENT_API
+void                    prestoclient_batch_delete               (PRESTOCLIENT_BATCH *batch);
+
+/**
+ * \brief               Write callback function that adds the current row to the batch
+ *
+ * \param in_batch      The PRESTOCLIENT_BATCH passed as client object to prestoclient_query
+ * \param in_result     A handle to a PRESTOCLIENT_RESULT object
+ */
+PRESTOCLIENT_API
+void                    prestoclient_batch_writecallback        (void *in_batch, void *in_result);
+
+/**
+ * \brief               Remove all rows from the batch. The buffers are kept for the next rows
+ *
+ * \param batch         A handle to a PRESTOCLIENT_BATCH object
+ */
+PRESTOCLIENT_API
+void                    prestoclient_batch_clear                (PRESTOCLIENT_BATCH *batch);
+
+/**
+ * \brief               Return the number of rows in the batch
+ *
+ * \param batch         A handle to a PRESTOCLIENT_BATCH object
+ *
+ * \return              Number of rows
+ */
+PRESTOCLIENT_API
+unsigned int            prestoclient_batch_getrowcount          (PRESTOCLIENT_BATCH *batch);
+
+/**
+ * \brief               Return the number of columns in the batch, 0 until the first row was added
+ *
+ * \param batch         A handle to a PRESTOCLIENT_BATCH object
+ *
+ * \return              Number of columns
+ */
+PRESTOCLIENT_API
+unsigned int            prestoclient_batch_getcolumncount       (PRESTOCLIENT_BATCH *batch);
+
+/**
+ * \brief               Return how the values of a column are stored
+ *
+ * \param batch         A handle to a PRESTOCLIENT_BATCH object
+ * \param columnindex   Index of the column, starting at 0
+ *
+ * \return              Numeric value corresponding to enum E_BATCHTYPES
+ */
+PRESTOCLIENT_API
+unsigned int            prestoclient_batch_getcolumntype        (PRESTOCLIENT_BATCH *batch, const unsigned int columnindex);
+
+/**
+ * \brief               Return the values of a column, an array of rowcount values or the text of all values
+ *
+ * \param batch         A handle to a PRESTOCLIENT_BATCH object
+ * \param columnindex   Index of the column, starting at 0
+ *
+ * \return              Pointer to the values, valid until the next row is added or the batch is deleted
+ */
+PRESTOCLIENT_API
+void*                   prestoclient_batch_getvalues            (PRESTOCLIENT_BATCH *batch, const unsigned int columnindex);
+
+/**
+ * \brief               Return the offsets of the values of a text column
+ *                      Value n starts at offsets[n] in the text and ends before offsets[n + 1] - 1, where the zero byte
+ *                      following the value is. offsets[rowcount] is the size of the text.
+ *
+ * \param batch         A handle to a PRESTOCLIENT_BATCH object
+ * \param columnindex   Index of the column, starting at 0
+ *
+ * \return              Array of rowcount + 1 offsets or NULL if the column is not a text column
+ */
+PRESTOCLIENT_API
+unsigned int*           prestoclient_batch_getoffsets           (PRESTOCLIENT_BATCH *batch, const unsigned int columnindex);
+
+/**
+ * \brief               Return which values of a column are null
+ *
+ * \param batch         A handle to a PRESTOCLIENT_BATCH object
+ * \param columnindex   Index of the column, starting at 0
+ *
+ * \return              Array of rowcount chars, 1 for null values and 0 for others
+ */
+PRESTOCLIENT_API
+char*                   prestoclient_batch_getnulls             (PRESTOCLIENT_BATCH *batch, const unsigned int columnindex);
+
+/**
+ * \brief               Return the number of null values in a column
+ *
+ * \param batch         A handle to a PRESTOCLIENT_BATCH object
+ * \param columnindex   Index of the column, starting at 0
+ *
+ * \return              Number of null values, when 0 the nulls array can be skipped
+ */
+PRESTOCLIENT_API
+unsigned int            prestoclient_batch_getnullcount         (PRESTOCLIENT_BATCH *batch, const unsigned int columnindex);
+
 #ifdef __cplusplus
 }
 #endif
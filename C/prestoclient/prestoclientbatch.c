@@ -0,0 +1,423 @@
+/*
+* This file is part of cPrestoClient
+*
+* Copyright (C) 2014 Ivo Herweijer
+*
+* cPrestoClient is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+* You can contact me via email: info@easydatawarehousing.com
+*/
+
+// Columnar batches of rows, for bindings from other languages. Calling a function for every value is slow
+// from languages like Python, a batch collects the rows of one or more responses per column so the binding
+// can copy every column in one go. Bigint, double and boolean values are converted here, all other types are
+// kept as text, with the json escape sequences translated.
+
+#include "prestoclient.h"
+#include "prestoclienttypes.h"
+
+/* --- Defines -------------------------------------------------------------------------------------------------------- */
+#define BATCH_INITIALROWS 1024										// Number of rows reserved when the first row is added
+
+/* --- Structs -------------------------------------------------------------------------------------------------------- */
+typedef struct ST_BATCHCOLUMN
+{
+	enum E_BATCHTYPES			  type;							// How the values are stored
+	char						 *values;						// Typed values, or the text of all values
+	size_t						  textsize;						// Text columns: used size of values
+	size_t						  textbuffersize;				// Text columns: allocated size of values
+	unsigned int				 *offsets;						// Text columns: start of every value in values, one extra for the end
+	char						 *nulls;						// 1 for every null value
+	unsigned int				  nullcount;					// Number of null values
+} BATCHCOLUMN;
+
+struct ST_PRESTOCLIENT_BATCH
+{
+	unsigned int				  columncount;					// Number of columns, 0 until the first row was added
+	unsigned int				  rowcount;						// Number of rows in the batch
+	unsigned int				  rowbuffersize;				// Number of rows that fit in the buffers
+	BATCHCOLUMN					 *columns;						// Array of columns
+};
+
+/* --- Private functions ---------------------------------------------------------------------------------------------- */
+static size_t batch_valuesize(enum E_BATCHTYPES type)
+{
+	switch (type)
+	{
+		case PRESTOCLIENT_BATCH_BIGINT:  return sizeof(long long);
+		case PRESTOCLIENT_BATCH_DOUBLE:  return sizeof(double);
+		case PRESTOCLIENT_BATCH_BOOLEAN: return sizeof(char);
+		default:                         return 0;
+	}
+}
+
+static void* batch_realloc(void *buffer, size_t size)
+{
+	buffer = realloc(buffer, size);
+
+	if (!buffer)
+		exit(1);
+
+	return buffer;
+}
+
+// Columns are known when the first row arrives
+static void batch_init_columns(PRESTOCLIENT_BATCH *batch, PRESTOCLIENT_RESULT *result)
+{
+	unsigned int i;
+
+	batch->columncount = result->columncount;
+	batch->columns     = (BATCHCOLUMN*)calloc(batch->columncount, sizeof(BATCHCOLUMN) );
+
+	if (!batch->columns)
+		exit(1);
+
+	for (i = 0; i < batch->columncount; i++)
+	{
+		switch (result->columns[i]->type)
+		{
+			case PRESTOCLIENT_TYPE_BIGINT:  batch->columns[i].type = PRESTOCLIENT_BATCH_BIGINT;  break;
+			case PRESTOCLIENT_TYPE_DOUBLE:  batch->columns[i].type = PRESTOCLIENT_BATCH_DOUBLE;  break;
+			case PRESTOCLIENT_TYPE_BOOLEAN: batch->columns[i].type = PRESTOCLIENT_BATCH_BOOLEAN; break;
+			default:                        batch->columns[i].type = PRESTOCLIENT_BATCH_TEXT;    break;
+		}
+	}
+}
+
+static void batch_grow(PRESTOCLIENT_BATCH *batch)
+{
+	BATCHCOLUMN *column;
+	unsigned int i;
+
+	batch->rowbuffersize = batch->rowbuffersize == 0 ? BATCH_INITIALROWS : batch->rowbuffersize * 2;
+
+	for (i = 0; i < batch->columncount; i++)
+	{
+		column = &batch->columns[i];
+
+		column->nulls = (char*)batch_realloc(column->nulls, batch->rowbuffersize);
+
+		if (column->type == PRESTOCLIENT_BATCH_TEXT)
+		{
+			column->offsets = (unsigned int*)batch_realloc(column->offsets, (batch->rowbuffersize + 1) * sizeof(unsigned int) );
+
+			if (batch->rowcount == 0)
+				column->offsets[0] = 0;
+		}
+		else
+			column->values = (char*)batch_realloc(column->values, batch->rowbuffersize * batch_valuesize(column->type) );
+	}
+}
+
+// Value of 4 hexadecimal digits, or -1 if they aren't
+static long batch_hexvalue(const char *hex)
+{
+	long value = 0;
+	unsigned int i;
+
+	for (i = 0; i < 4; i++)
+	{
+		if      (hex[i] >= '0' && hex[i] <= '9') value = value * 16 + hex[i] - '0';
+		else if (hex[i] >= 'a' && hex[i] <= 'f') value = value * 16 + hex[i] - 'a' + 10;
+		else if (hex[i] >= 'A' && hex[i] <= 'F') value = value * 16 + hex[i] - 'A' + 10;
+		else return -1;
+	}
+
+	return value;
+}
+
+static unsigned int batch_utf8(char *target, long code)
+{
+	if (code < 0x80)
+	{
+		target[0] = (char)code;
+		return 1;
+	}
+
+	if (code < 0x800)
+	{
+		target[0] = (char)(0xC0 | (code >> 6) );
+		target[1] = (char)(0x80 | (code & 0x3F) );
+		return 2;
+	}
+
+	if (code < 0x10000)
+	{
+		target[0] = (char)(0xE0 | (code >> 12) );
+		target[1] = (char)(0x80 | ( (code >> 6) & 0x3F) );
+		target[2] = (char)(0x80 | (code & 0x3F) );
+		return 3;
+	}
+
+	target[0] = (char)(0xF0 | (code >> 18) );
+	target[1] = (char)(0x80 | ( (code >> 12) & 0x3F) );
+	target[2] = (char)(0x80 | ( (code >> 6) & 0x3F) );
+	target[3] = (char)(0x80 | (code & 0x3F) );
+	return 4;
+}
+
+// The json parser keeps escape sequences, translate them. The result is never longer than the source
+static unsigned int batch_unescape(char *target, const char *source, unsigned int length)
+{
+	unsigned int i = 0, size = 0;
+	long code, low;
+
+	while (i < length)
+	{
+		if (source[i] != '\\' || i + 1 >= length)
+		{
+			target[size++] = source[i++];
+			continue;
+		}
+
+		switch (source[i + 1])
+		{
+			case 'b': target[size++] = '\b'; break;
+			case 'f': target[size++] = '\f'; break;
+			case 'n': target[size++] = '\n'; break;
+			case 'r': target[size++] = '\r'; break;
+			case 't': target[size++] = '\t'; break;
+
+			case 'u':
+			{
+				code = i + 6 <= length ? batch_hexvalue(source + i + 2) : -1;
+
+				if (code < 0)
+				{
+					// Not a valid escape sequence, keep it
+					target[size++] = source[i++];
+					continue;
+				}
+
+				i += 6;
+
+				// Characters outside the basic multilingual plane are sent as a surrogate pair
+				if (code >= 0xD800 && code <= 0xDBFF && i + 6 <= length && source[i] == '\\' && source[i + 1] == 'u')
+				{
+					low = batch_hexvalue(source + i + 2);
+
+					if (low >= 0xDC00 && low <= 0xDFFF)
+					{
+						code = 0x10000 + ( (code - 0xD800) << 10) + (low - 0xDC00);
+						i += 6;
+					}
+				}
+
+				size += batch_utf8(target + size, code);
+				continue;
+			}
+
+			default:
+			{
+				// Quote, backslash and slash
+				target[size++] = source[i + 1];
+				break;
+			}
+		}
+
+		i += 2;
+	}
+
+	return size;
+}
+
+// Only json strings are unescaped, values of array, map and row columns stay json text
+static void batch_add_text(BATCHCOLUMN *column, unsigned int row, const char *data, unsigned int length, bool isstring)
+{
+	// Every value is followed by a zero, so the text can also be split on zeros
+	if (column->textsize + length + 1 > column->textbuffersize)
+	{
+		column->textbuffersize = (column->textsize + length + 1) * 2;
+		column->values         = (char*)batch_realloc(column->values, column->textbuffersize);
+	}
+
+	if (length > 0 && isstring && memchr(data, '\\', length) )
+		length = batch_unescape(column->values + column->textsize, data, length);
+	else if (length > 0)
+		memcpy(column->values + column->textsize, data, length);
+
+	column->textsize += length;
+	column->values[column->textsize++] = 0;
+	column->offsets[row + 1] = (unsigned int)column->textsize;
+}
+
+/* --- Public functions ----------------------------------------------------------------------------------------------- */
+PRESTOCLIENT_BATCH* prestoclient_batch_new()
+{
+	PRESTOCLIENT_BATCH *batch = (PRESTOCLIENT_BATCH*)calloc(1, sizeof(PRESTOCLIENT_BATCH) );
+
+	if (!batch)
+		exit(1);
+
+	return batch;
+}
+
+void prestoclient_batch_delete(PRESTOCLIENT_BATCH *batch)
+{
+	unsigned int i;
+
+	if (!batch)
+		return;
+
+	for (i = 0; i < batch->columncount; i++)
+	{
+		if (batch->columns[i].values)
+			free(batch->columns[i].values);
+
+		if (batch->columns[i].offsets)
+			free(batch->columns[i].offsets);
+
+		if (batch->columns[i].nulls)
+			free(batch->columns[i].nulls);
+	}
+
+	if (batch->columns)
+		free(batch->columns);
+
+	free(batch);
+}
+
+void prestoclient_batch_writecallback(void *in_batch, void *in_result)
+{
+	PRESTOCLIENT_BATCH	*batch  = (PRESTOCLIENT_BATCH*)in_batch;
+	PRESTOCLIENT_RESULT	*result = (PRESTOCLIENT_RESULT*)in_result;
+	PRESTOCLIENT_FIELD	*field;
+	BATCHCOLUMN			*column;
+	unsigned int		 i, row;
+
+	if (!batch || !result)
+		return;
+
+	if (batch->columncount == 0)
+		batch_init_columns(batch, result);
+
+	if (batch->columncount != result->columncount)
+		return;
+
+	if (batch->rowcount == batch->rowbuffersize)
+		batch_grow(batch);
+
+	row = batch->rowcount;
+
+	for (i = 0; i < batch->columncount; i++)
+	{
+		field  = result->columns[i];
+		column = &batch->columns[i];
+
+		column->nulls[row] = field->dataisnull ? 1 : 0;
+
+		if (field->dataisnull)
+			column->nullcount++;
+
+		switch (column->type)
+		{
+			case PRESTOCLIENT_BATCH_BIGINT:
+			{
+				( (long long*)column->values)[row] = field->dataisnull ? 0 : strtoll(field->data, NULL, 10);
+				break;
+			}
+
+			case PRESTOCLIENT_BATCH_DOUBLE:
+			{
+				// Presto sends NaN and Infinity as strings, strtod understands both
+				( (double*)column->values)[row] = field->dataisnull ? 0.0 : strtod(field->data, NULL);
+				break;
+			}
+
+			case PRESTOCLIENT_BATCH_BOOLEAN:
+			{
+				// The json parser stores true as 1 and false as 0
+				column->values[row] = !field->dataisnull && field->data[0] == '1' ? 1 : 0;
+				break;
+			}
+
+			default:
+			{
+				if (field->dataisnull)
+					batch_add_text(column, row, NULL, 0, false);
+				else
+					batch_add_text(column, row, field->data, field->datalength, field->dataisstring);
+				break;
+			}
+		}
+	}
+
+	batch->rowcount++;
+}
+
+void prestoclient_batch_clear(PRESTOCLIENT_BATCH *batch)
+{
+	unsigned int i;
+
+	if (!batch)
+		return;
+
+	for (i = 0; i < batch->columncount; i++)
+	{
+		batch->columns[i].textsize  = 0;
+		batch->columns[i].nullcount = 0;
+	}
+
+	batch->rowcount = 0;
+}
+
+unsigned int prestoclient_batch_getrowcount(PRESTOCLIENT_BATCH *batch)
+{
+	return batch ? batch->rowcount : 0;
+}
+
+unsigned int prestoclient_batch_getcolumncount(PRESTOCLIENT_BATCH *batch)
+{
+	return batch ? batch->columncount : 0;
+}
+
+unsigned int prestoclient_batch_getcolumntype(PRESTOCLIENT_BATCH *batch, const unsigned int columnindex)
+{
+	if (!batch || columnindex >= batch->columncount)
+		return PRESTOCLIENT_BATCH_TEXT;
+
+	return batch->columns[columnindex].type;
+}
+
+void* prestoclient_batch_getvalues(PRESTOCLIENT_BATCH *batch, const unsigned int columnindex)
+{
+	if (!batch || columnindex >= batch->columncount)
+		return NULL;
+
+	return (void*)batch->columns[columnindex].values;
+}
+
+unsigned int* prestoclient_batch_getoffsets(PRESTOCLIENT_BATCH *batch, const unsigned int columnindex)
+{
+	if (!batch || columnindex >= batch->columncount)
+		return NULL;
+
+	return batch->columns[columnindex].offsets;
+}
+
+char* prestoclient_batch_getnulls(PRESTOCLIENT_BATCH *batch, const unsigned int columnindex)
+{
+	if (!batch || columnindex >= batch->columncount)
+		return NULL;
+
+	return batch->columns[columnindex].nulls;
+}
+
+unsigned int prestoclient_batch_getnullcount(PRESTOCLIENT_BATCH *batch, const unsigned int columnindex)
+{
+	if (!batch || columnindex >= batch->columncount)
+		return 0;
+
+	return batch->columns[columnindex].nullcount;
+}
@@ -46,6 +46,8 @@ static JSONPARSER* json_new_parser()
 	if (!json->tagbuffer)
 		exit(1);
 
+	json->tagbuffer[0]			= 0;
+
 	return json;
 }
 
@@ -75,6 +77,11 @@ static JSONLEXER* json_new_lexer()
 	lexer->value				= (char*)malloc(lexer->valuesize + 1);
 	lexer->valueactualsize		= 0;
 
+	lexer->nestedsize			= 0;
+	lexer->nested				= NULL;
+	lexer->nestedactualsize		= 0;
+	lexer->nesteddepth			= 0;
+
 	if (!lexer->tagorder || ! lexer->name || ! lexer->value)
 		exit(1);
 
@@ -121,6 +128,7 @@ static void json_add_lexer_tagorder(JSONLEXER* lexer, const enum E_JSON_TAGTYPES
 
 	lexer->tagorder[lexer->tagorderactualsize - 1] = newtagorder;
 	strncpy(lexer->tagordername[lexer->tagorderactualsize - 1], newtagordername, 20);
+	lexer->tagordername[lexer->tagorderactualsize - 1][20] = 0;
 }
 
 static void json_remove_lexer_last_tagorder(JSONLEXER* lexer)
@@ -173,6 +181,27 @@ static bool json_in_array(JSONLEXER* lexer)
 	return false;
 }
 
+// True when the current tag is a value in a row of the data array
+static bool json_in_datarow(JSONLEXER* lexer)
+{
+	return (lexer->tagorderactualsize > 2 && strcmp(lexer->tagordername[lexer->tagorderactualsize - 2], "data") == 0);
+}
+
+static void json_addtonested(JSONLEXER* lexer, const char *text, unsigned int length)
+{
+	if (lexer->nestedactualsize + length >= lexer->nestedsize)
+	{
+		lexer->nestedsize = (lexer->nestedactualsize + length) * 2 + 64;
+		lexer->nested = (char*)realloc( (char*)lexer->nested, lexer->nestedsize);
+		if (!lexer->nested)
+			exit(1);
+	}
+
+	memcpy(lexer->nested + lexer->nestedactualsize, text, length);
+	lexer->nestedactualsize += length;
+	lexer->nested[lexer->nestedactualsize] = 0;
+}
+
 static bool json_getnextchar(PRESTOCLIENT_RESULT* result)
 {
 	if (!result)
@@ -443,9 +472,105 @@ static bool json_parser(PRESTOCLIENT_RESULT* result)
 // Forward declaration
 static void json_extract_variables(PRESTOCLIENT_RESULT *result);
 
+// Adds a tag to the value of an array, map or row column. The value is complete when its outer array or object closes.
+// Strings keep their escape sequences, so the text is valid json
+static void json_nested_lexer(PRESTOCLIENT_RESULT* result)
+{
+	JSONLEXER *lexer = result->lexer;
+	JSONPARSER *json = result->json;
+
+	switch (json->tagtype)
+	{
+		case JSON_TT_UNKNOWN:
+		{
+			lexer->error = true;
+			break;
+		}
+
+		case JSON_TT_OBJECT_OPEN:
+		case JSON_TT_ARRAY_OPEN:
+		{
+			json_add_lexer_tagorder(lexer, json->tagtype, "");
+			json_addtonested(lexer, json->tagtype == JSON_TT_OBJECT_OPEN ? "{" : "[", 1);
+			break;
+		}
+
+		case JSON_TT_OBJECT_CLOSE:
+		case JSON_TT_ARRAY_CLOSE:
+		{
+			json_addtonested(lexer, json->tagtype == JSON_TT_OBJECT_CLOSE ? "}" : "]", 1);
+			json_remove_lexer_last_tagorder(lexer);
+
+			if (lexer->tagorderactualsize < lexer->nesteddepth)
+			{
+				lexer->nesteddepth = 0;
+				json_copytag(&lexer->value, &lexer->valuesize, &lexer->valueactualsize, &json->tagbuffer, &json->tagbufferactualsize, lexer->nested);
+				json_extract_variables(result);
+			}
+			break;
+		}
+
+		case JSON_TT_COLON:
+		{
+			json_addtonested(lexer, ":", 1);
+			break;
+		}
+
+		case JSON_TT_COMMA:
+		{
+			json_addtonested(lexer, ",", 1);
+			break;
+		}
+
+		case JSON_TT_STRING:
+		{
+			json_addtonested(lexer, "\"", 1);
+			json_addtonested(lexer, json->tagbuffer, json->tagbufferactualsize);
+			json_addtonested(lexer, "\"", 1);
+			break;
+		}
+
+		case JSON_TT_NUMBER:
+		{
+			json_addtonested(lexer, json->tagbuffer, json->tagbufferactualsize);
+			break;
+		}
+
+		case JSON_TT_TRUE:
+		{
+			json_addtonested(lexer, "true", 4);
+			break;
+		}
+
+		case JSON_TT_FALSE:
+		{
+			json_addtonested(lexer, "false", 5);
+			break;
+		}
+
+		case JSON_TT_NULL:
+		{
+			json_addtonested(lexer, "null", 4);
+			break;
+		}
+	}
+
+	json->tagbuffer[0] = 0;
+	json->tagbufferactualsize = 0;
+}
+
 // Lexical analysis
 static bool json_lexer(PRESTOCLIENT_RESULT* result)
 {
+	// Inside the value of an array, map or row column
+	if (result->lexer->nesteddepth > 0)
+	{
+		json_nested_lexer(result);
+		result->lexer->previoustag = result->json->tagtype;
+
+		return (!result->lexer->error);
+	}
+
 	switch (result->json->tagtype)
 	{
 		case JSON_TT_UNKNOWN:
@@ -457,6 +582,16 @@ static bool json_lexer(PRESTOCLIENT_RESULT* result)
 		case JSON_TT_OBJECT_OPEN:
 		case JSON_TT_ARRAY_OPEN:
 		{
+			// An array or object in a row of data is the value of an array, map or row column
+			if (json_in_datarow(result->lexer) )
+			{
+				result->lexer->nestedactualsize = 0;
+				json_addtonested(result->lexer, result->json->tagtype == JSON_TT_OBJECT_OPEN ? "{" : "[", 1);
+				json_add_lexer_tagorder(result->lexer, result->json->tagtype, "");
+				result->lexer->nesteddepth = result->lexer->tagorderactualsize;
+				break;
+			}
+
 			json_add_lexer_tagorder(result->lexer, result->json->tagtype, result->lexer->name);
 			result->lexer->name[0] = 0;
 			break;
@@ -472,7 +607,11 @@ static bool json_lexer(PRESTOCLIENT_RESULT* result)
 		case JSON_TT_OBJECT_CLOSE:
 		case JSON_TT_ARRAY_CLOSE:
 		{
-			json_remove_lexer_last_tagorder(result->lexer);
+			// Closing more than was opened, or a row of data with fewer values than columns
+			if (result->lexer->tagorderactualsize == 0 || (json_in_datarow(result->lexer) && result->currentdatacolumn != -1) )
+				result->lexer->error = true;
+			else
+				json_remove_lexer_last_tagorder(result->lexer);
 			break;
 		}
 
@@ -532,6 +671,10 @@ static void json_extract_variables(PRESTOCLIENT_RESULT *result);
 
 bool json_reader(PRESTOCLIENT_RESULT* result)
 {
+	TRACE_DECLARE(tracestart);
+
+	TRACE_BEGIN(tracestart);
+
 	if (!result->json)
 		result->json = json_new_parser();
 
@@ -556,13 +699,15 @@ bool json_reader(PRESTOCLIENT_RESULT* result)
 	else
 	{
 		// we need to preserve the unhandled remainder of the curl buffer (Should be no more than 4 bytes = 1 utf-8 character)
-		// This piece of code is not thoroughly tested yet!
-		memcpy( (void*)result->lastresponse, (void*)(&result->lastresponse[result->json->readposition]), result->lastresponseactualsize - result->json->readposition + 1);
-		result->lastresponseactualsize -= result->json->readposition - 1;
+		// Splits at every position are tested by tools/jsonsplit
+		memmove( (void*)result->lastresponse, (void*)(&result->lastresponse[result->json->readposition]), result->lastresponseactualsize - result->json->readposition + 1);
+		result->lastresponseactualsize -= result->json->readposition;
 		result->lastresponse[result->lastresponseactualsize] = 0;
 		result->json->readposition = 0;
 	}
 
+	TRACE_END(tracestart, "json reader", "total bytes", result->stats.bytes);
+
 	return (!result->json->error && !result->lexer->error);
 }
 
@@ -602,6 +747,9 @@ void json_delete_lexer(JSONLEXER* lexer)
 	if (lexer->value)
 		free(lexer->value);
 
+	if (lexer->nested)
+		free(lexer->nested);
+
 	free(lexer);
 }
 
@@ -625,6 +773,9 @@ void json_reset_lexer(JSONLEXER* lexer)
 	lexer->value[0]				= 0;
 	lexer->valueactualsize		= 0;
 
+	lexer->nestedactualsize		= 0;
+	lexer->nesteddepth			= 0;
+
 	for (i = 0; i < lexer->tagordersize; i++)
 	{
 		lexer->tagorder[i] = JSON_TT_UNKNOWN;
@@ -632,6 +783,29 @@ void json_reset_lexer(JSONLEXER* lexer)
 	}
 }
 
+// Store a value of the stats object. Unknown names are ignored
+static void json_extract_serverstats(PRESTOCLIENT_RESULT *result)
+{
+	PRESTOCLIENT_SERVERSTATS	*stats = &result->serverstats;
+	const char					*name  = result->lexer->name;
+	unsigned long long			 value = strtoull(result->lexer->value, NULL, 10);
+
+	if      (strcmp(name, "scheduled")         == 0)	stats->scheduled         = (value != 0);
+	else if (strcmp(name, "nodes")             == 0)	stats->nodes             = value;
+	else if (strcmp(name, "totalSplits")       == 0)	stats->totalsplits       = value;
+	else if (strcmp(name, "queuedSplits")      == 0)	stats->queuedsplits      = value;
+	else if (strcmp(name, "runningSplits")     == 0)	stats->runningsplits     = value;
+	else if (strcmp(name, "completedSplits")   == 0)	stats->completedsplits   = value;
+	else if (strcmp(name, "userTimeMillis")    == 0)	stats->usertimemillis    = value;
+	else if (strcmp(name, "cpuTimeMillis")     == 0)	stats->cputimemillis     = value;
+	else if (strcmp(name, "wallTimeMillis")    == 0)	stats->walltimemillis    = value;
+	else if (strcmp(name, "queuedTimeMillis")  == 0)	stats->queuedtimemillis  = value;
+	else if (strcmp(name, "elapsedTimeMillis") == 0)	stats->elapsedtimemillis = value;
+	else if (strcmp(name, "processedRows")     == 0)	stats->processedrows     = value;
+	else if (strcmp(name, "processedBytes")    == 0)	stats->processedbytes    = value;
+	else if (strcmp(name, "peakMemoryBytes")   == 0)	stats->peakmemorybytes   = value;
+}
+
 // This function is specific to prestoclient, not generic json
 static void json_extract_variables(PRESTOCLIENT_RESULT *result)
 {
@@ -651,26 +825,39 @@ static void json_extract_variables(PRESTOCLIENT_RESULT *result)
 				result->columninfoprinted = true;
 
 				if (result->describe_callback_function)
+				{
+					double starttime = util_gettime();
+					TRACE_DECLARE(tracestart);
+
+					TRACE_BEGIN(tracestart);
 					result->describe_callback_function(result->client_object, (void*)result);
+					result->stats.callbacktime += util_gettime() - starttime;
+					TRACE_END(tracestart, "describe callback", NULL, 0);
+				}
 			}
 		}
 
-		assert(result->columninfoavailable);
-
 		// Determine column
 		result->currentdatacolumn++;
 
-		assert(result->currentdatacolumn < (int)result->columncount);
-
+		// Data without column info or with too many values can't be handled
+		if (!result->columninfoavailable || result->currentdatacolumn >= (int)result->columncount)
+		{
+			result->lexer->error = true;
+			result->currentdatacolumn = -1;
+		}
 		// Copy value
-		if (result->json->tagtype == JSON_TT_NULL)
+		else if (result->json->tagtype == JSON_TT_NULL)
 		{
 			result->columns[result->currentdatacolumn]->dataisnull = true;
+			result->columns[result->currentdatacolumn]->dataisstring = false;
 			result->columns[result->currentdatacolumn]->data[0] = 0;
+			result->columns[result->currentdatacolumn]->datalength = 0;
 		}
 		else
 		{
 			result->columns[result->currentdatacolumn]->dataisnull = false;
+			result->columns[result->currentdatacolumn]->dataisstring = (result->json->tagtype == JSON_TT_STRING);
 
 			if (result->lexer->valueactualsize > result->columns[result->currentdatacolumn]->datasize)
 			{
@@ -680,18 +867,29 @@ static void json_extract_variables(PRESTOCLIENT_RESULT *result)
 					exit(1);
 			}
 
-			strncpy(result->columns[result->currentdatacolumn]->data, result->lexer->value, result->lexer->valueactualsize + 1);	// +1 to copy null terminator
+			memcpy(result->columns[result->currentdatacolumn]->data, result->lexer->value, result->lexer->valueactualsize + 1);	// +1 to copy null terminator
+			result->columns[result->currentdatacolumn]->datalength = result->lexer->valueactualsize;
 		}
 
 		// Last column reached ?
-		if (result->currentdatacolumn >= (int)result->columncount - 1)
+		if (!result->lexer->error && result->currentdatacolumn >= (int)result->columncount - 1)
 		{
 			result->currentdatacolumn = -1;
 
 			// Call rowdata callback function
 			result->dataavailable = true;
+			result->stats.rows++;
+			result->stats.cells += result->columncount;
 			if (result->write_callback_function)
+			{
+				double starttime = util_gettime();
+				TRACE_DECLARE(tracestart);
+
+				TRACE_BEGIN(tracestart);
 				result->write_callback_function(result->client_object, (void*)result);
+				result->stats.callbacktime += util_gettime() - starttime;
+				TRACE_END(tracestart, "write callback", "row", result->stats.rows);
+			}
 		}
 	}
 	//  Get URI's and state
@@ -711,10 +909,12 @@ static void json_extract_variables(PRESTOCLIENT_RESULT *result)
 		alloc_copy(&result->lastcanceluri, result->lexer->value);
 	}
 	else if (result->lexer->tagorderactualsize > 1 &&
-			 strcmp(result->lexer->tagordername[result->lexer->tagorderactualsize - 1], "stats") == 0 &&
-			 strcmp(result->lexer->name, "state") == 0 )
+			 strcmp(result->lexer->tagordername[result->lexer->tagorderactualsize - 1], "stats") == 0 )
 	{
-		alloc_copy(&result->laststate, result->lexer->value);
+		if (strcmp(result->lexer->name, "state") == 0)
+			alloc_copy(&result->laststate, result->lexer->value);
+		else
+			json_extract_serverstats(result);
 	}
 	// Get error message
 	else if (result->lexer->tagorderactualsize > 2 &&
@@ -730,6 +930,7 @@ static void json_extract_variables(PRESTOCLIENT_RESULT *result)
 			 strcmp(result->lexer->name, "message") == 0 )
 	{
 		alloc_add(&result->lasterrormessage, result->lexer->value);
+		alloc_copy(&result->lastservermessage, result->lexer->value);
 	}
 	// Extract column info
 	else if (!result->columninfoavailable &&
@@ -757,12 +958,15 @@ static void json_extract_variables(PRESTOCLIENT_RESULT *result)
 		}
 		else if (result->columncount > 0 && strcmp(result->lexer->name, "type") == 0 )
 		{
-			// Store column type
-			if      (strcmp(result->lexer->value, "bigint") == 0)
+			alloc_copy(&result->columns[result->columncount - 1]->servertype, result->lexer->value);
+
+			// Store column type, the smaller integer and floating point types are handled like bigint and double
+			if      (strcmp(result->lexer->value, "bigint") == 0 || strcmp(result->lexer->value, "integer") == 0 ||
+					 strcmp(result->lexer->value, "smallint") == 0 || strcmp(result->lexer->value, "tinyint") == 0)
 				result->columns[result->columncount - 1]->type = PRESTOCLIENT_TYPE_BIGINT;
 			else if (strcmp(result->lexer->value, "boolean") == 0)
 				result->columns[result->columncount - 1]->type = PRESTOCLIENT_TYPE_BOOLEAN;
-			else if (strcmp(result->lexer->value, "double") == 0)
+			else if (strcmp(result->lexer->value, "double") == 0 || strcmp(result->lexer->value, "real") == 0)
 				result->columns[result->columncount - 1]->type = PRESTOCLIENT_TYPE_DOUBLE;
 			else if (strcmp(result->lexer->value, "date") == 0)
 				result->columns[result->columncount - 1]->type = PRESTOCLIENT_TYPE_DATE;
@@ -779,10 +983,8 @@ static void json_extract_variables(PRESTOCLIENT_RESULT *result)
 			else if (strcmp(result->lexer->value, "interval day to second") == 0)
 				result->columns[result->columncount - 1]->type = PRESTOCLIENT_TYPE_INTERVAL_DAY_TO_SECOND;
 			else
-			{
-				assert(strcmp(result->lexer->value, "varchar") == 0);
+				// varchar and types not known to this client
 				result->columns[result->columncount - 1]->type = PRESTOCLIENT_TYPE_VARCHAR;
-			}
 		}
 		//	else
 			// An unknown field was encountered -> continue
@@ -0,0 +1,294 @@
+/*
+* This file is part of cPrestoClient
+*
+* Copyright (C) 2014 Ivo Herweijer
+*
+* cPrestoClient is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+* You can contact me via email: info@easydatawarehousing.com
+*/
+
+// Process wide metrics of all queries and http requests, for programs that run many queries. Counters are
+// updated with atomic operations so queries in different threads can update them without locking.
+// prestoclient_getmetrics renders them in the Prometheus text exposition format.
+//
+// A scrape reads all counters into a snapshot first. Totals are computed from the histogram buckets of that
+// snapshot, and counters that depend on another one are updated after it and read before it. So a scrape never
+// shows, for example, more errors than requests.
+
+#include "prestoclient.h"
+#include "prestoclienttypes.h"
+
+/* --- Defines -------------------------------------------------------------------------------------------------------- */
+#define METRICS_BUCKETCOUNT 14										// Number of histogram buckets, excluding +Inf
+#define METRICS_METHODCOUNT 3										// Number of http request types
+
+/* --- Structs -------------------------------------------------------------------------------------------------------- */
+typedef struct ST_METRICS_HISTOGRAM
+{
+	volatile unsigned long long	  buckets[METRICS_BUCKETCOUNT + 1];	// Number of observations per bucket (not cumulative), last is +Inf
+	volatile unsigned long long	  summicros;					// Sum of all observations in microseconds
+} METRICS_HISTOGRAM;
+
+typedef struct ST_METRICS
+{
+	volatile unsigned long long	  busy[METRICS_METHODCOUNT];			// Requests answered with 503, per request type
+	volatile unsigned long long	  errors[METRICS_METHODCOUNT];			// Requests that failed, per request type
+	volatile unsigned long long	  cancelled[METRICS_METHODCOUNT];		// Requests stopped because the query was cancelled
+	METRICS_HISTOGRAM			  requesttime[METRICS_METHODCOUNT];	// Duration of requests, per request type. Also counts them
+	volatile unsigned long long	  queries[3];							// Finished queries: succeeded, failed, cancelled
+	volatile unsigned long long	  running;								// Queries in progress
+	METRICS_HISTOGRAM			  querytime;							// Duration of finished queries
+	volatile unsigned long long	  rows;									// Rows received
+	volatile unsigned long long	  bytes;								// Bytes received
+} METRICS;
+
+/* --- Globals -------------------------------------------------------------------------------------------------------- */
+static METRICS metrics;
+
+static const double metrics_bucketbounds[METRICS_BUCKETCOUNT] = { 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0, 30.0, 60.0, 300.0 };
+
+static const char *metrics_methodnames[METRICS_METHODCOUNT] = { "get", "post", "delete" };	// Same order as E_HTTP_REQUEST_TYPES
+
+static const char *metrics_statusnames[3] = { "succeeded", "failed", "cancelled" };
+
+/* --- Private functions ---------------------------------------------------------------------------------------------- */
+static void metrics_observe(METRICS_HISTOGRAM *histogram, double seconds)
+{
+	unsigned int i;
+
+	for (i = 0; i < METRICS_BUCKETCOUNT && seconds > metrics_bucketbounds[i]; i++)
+		;
+
+	util_atomic_add(&histogram->buckets[i], 1);
+	util_atomic_add(&histogram->summicros, (unsigned long long)(seconds * 1e6) );
+}
+
+static void metrics_load_histogram(METRICS_HISTOGRAM *snapshot, METRICS_HISTOGRAM *histogram)
+{
+	unsigned int i;
+
+	for (i = 0; i <= METRICS_BUCKETCOUNT; i++)
+		snapshot->buckets[i] = util_atomic_load(&histogram->buckets[i]);
+
+	snapshot->summicros = util_atomic_load(&histogram->summicros);
+}
+
+// Number of observations in a histogram
+static unsigned long long metrics_count(const METRICS_HISTOGRAM *histogram)
+{
+	unsigned long long count = 0;
+	unsigned int i;
+
+	for (i = 0; i <= METRICS_BUCKETCOUNT; i++)
+		count += histogram->buckets[i];
+
+	return count;
+}
+
+// Read all counters. Counters updated after another one are read before it
+static void metrics_load(METRICS *snapshot)
+{
+	unsigned int i;
+
+	for (i = 0; i < METRICS_METHODCOUNT; i++)
+	{
+		snapshot->busy[i]      = util_atomic_load(&metrics.busy[i]);
+		snapshot->errors[i]    = util_atomic_load(&metrics.errors[i]);
+		snapshot->cancelled[i] = util_atomic_load(&metrics.cancelled[i]);
+	}
+
+	for (i = 0; i < METRICS_METHODCOUNT; i++)
+		metrics_load_histogram(&snapshot->requesttime[i], &metrics.requesttime[i]);
+
+	for (i = 0; i < 3; i++)
+		snapshot->queries[i] = util_atomic_load(&metrics.queries[i]);
+
+	metrics_load_histogram(&snapshot->querytime, &metrics.querytime);
+
+	snapshot->running = util_atomic_load(&metrics.running);
+	snapshot->rows    = util_atomic_load(&metrics.rows);
+	snapshot->bytes   = util_atomic_load(&metrics.bytes);
+}
+
+static void metrics_print_histogram(char **text, const char *name, const char *label, const METRICS_HISTOGRAM *histogram)
+{
+	char line[256];
+	unsigned long long cumulative = 0, count = metrics_count(histogram);
+	unsigned int i;
+
+	for (i = 0; i < METRICS_BUCKETCOUNT; i++)
+	{
+		cumulative += histogram->buckets[i];
+		sprintf(line, "%s_bucket{%sle=\"%g\"} %llu", name, label, metrics_bucketbounds[i], cumulative);
+		alloc_add(text, line);
+	}
+
+	sprintf(line, "%s_bucket{%sle=\"+Inf\"} %llu", name, label, count);
+	alloc_add(text, line);
+
+	// Strip the trailing comma of the label for the sum and count series
+	if (strlen(label) > 0)
+	{
+		sprintf(line, "%s_sum{%.*s} %.6f", name, (int)strlen(label) - 1, label, histogram->summicros / 1e6);
+		alloc_add(text, line);
+		sprintf(line, "%s_count{%.*s} %llu", name, (int)strlen(label) - 1, label, count);
+	}
+	else
+	{
+		sprintf(line, "%s_sum %.6f", name, histogram->summicros / 1e6);
+		alloc_add(text, line);
+		sprintf(line, "%s_count %llu", name, count);
+	}
+
+	alloc_add(text, line);
+}
+
+/* --- Public functions ----------------------------------------------------------------------------------------------- */
+void metrics_add_request(enum E_HTTP_REQUEST_TYPES request_type, double seconds, bool busy, bool error, bool cancelled)
+{
+	metrics_observe(&metrics.requesttime[request_type], seconds);
+
+	if (busy)
+		util_atomic_add(&metrics.busy[request_type], 1);
+
+	if (error)
+		util_atomic_add(&metrics.errors[request_type], 1);
+
+	if (cancelled)
+		util_atomic_add(&metrics.cancelled[request_type], 1);
+}
+
+void metrics_start_query()
+{
+	util_atomic_add(&metrics.running, 1);
+}
+
+void metrics_end_query(PRESTOCLIENT_RESULT *result, double seconds)
+{
+	unsigned int status;
+
+	if (result->errorcode == PRESTOCLIENT_RESULT_CANCELLED)
+		status = 2;
+	else if (result->clientstatus == PRESTOCLIENT_STATUS_SUCCEEDED)
+		status = 0;
+	else
+		status = 1;
+
+	metrics_observe(&metrics.querytime, seconds);
+
+	util_atomic_add(&metrics.queries[status], 1);
+	util_atomic_add(&metrics.running, (unsigned long long)-1);
+	util_atomic_add(&metrics.rows, result->stats.rows);
+	util_atomic_add(&metrics.bytes, result->stats.bytes);
+}
+
+unsigned int prestoclient_getmetrics(char *buffer, unsigned int buffersize)
+{
+	METRICS snapshot;
+	char *text = NULL, line[256], label[64];
+	unsigned int length;
+	unsigned int i;
+
+	metrics_load(&snapshot);
+
+	alloc_add(&text, "# HELP prestoclient_queries_total Queries finished, by final status.");
+	alloc_add(&text, "# TYPE prestoclient_queries_total counter");
+
+	for (i = 0; i < 3; i++)
+	{
+		sprintf(line, "prestoclient_queries_total{status=\"%s\"} %llu", metrics_statusnames[i], snapshot.queries[i]);
+		alloc_add(&text, line);
+	}
+
+	alloc_add(&text, "# HELP prestoclient_queries_running Queries in progress.");
+	alloc_add(&text, "# TYPE prestoclient_queries_running gauge");
+	sprintf(line, "prestoclient_queries_running %lld", (long long)snapshot.running);
+	alloc_add(&text, line);
+
+	alloc_add(&text, "# HELP prestoclient_query_duration_seconds Time from sending a query until the last response.");
+	alloc_add(&text, "# TYPE prestoclient_query_duration_seconds histogram");
+	metrics_print_histogram(&text, "prestoclient_query_duration_seconds", "", &snapshot.querytime);
+
+	alloc_add(&text, "# HELP prestoclient_http_requests_total Http requests sent to the Presto server, including retries.");
+	alloc_add(&text, "# TYPE prestoclient_http_requests_total counter");
+
+	for (i = 0; i < METRICS_METHODCOUNT; i++)
+	{
+		sprintf(line, "prestoclient_http_requests_total{method=\"%s\"} %llu", metrics_methodnames[i], metrics_count(&snapshot.requesttime[i]));
+		alloc_add(&text, line);
+	}
+
+	alloc_add(&text, "# HELP prestoclient_http_busy_total Http requests answered with 503 server busy.");
+	alloc_add(&text, "# TYPE prestoclient_http_busy_total counter");
+
+	for (i = 0; i < METRICS_METHODCOUNT; i++)
+	{
+		sprintf(line, "prestoclient_http_busy_total{method=\"%s\"} %llu", metrics_methodnames[i], snapshot.busy[i]);
+		alloc_add(&text, line);
+	}
+
+	alloc_add(&text, "# HELP prestoclient_http_errors_total Http requests that failed with a curl error or an unexpected http code.");
+	alloc_add(&text, "# TYPE prestoclient_http_errors_total counter");
+
+	for (i = 0; i < METRICS_METHODCOUNT; i++)
+	{
+		sprintf(line, "prestoclient_http_errors_total{method=\"%s\"} %llu", metrics_methodnames[i], snapshot.errors[i]);
+		alloc_add(&text, line);
+	}
+
+	alloc_add(&text, "# HELP prestoclient_http_cancelled_total Http requests stopped by the client because the query was cancelled.");
+	alloc_add(&text, "# TYPE prestoclient_http_cancelled_total counter");
+
+	for (i = 0; i < METRICS_METHODCOUNT; i++)
+	{
+		sprintf(line, "prestoclient_http_cancelled_total{method=\"%s\"} %llu", metrics_methodnames[i], snapshot.cancelled[i]);
+		alloc_add(&text, line);
+	}
+
+	alloc_add(&text, "# HELP prestoclient_http_request_duration_seconds Duration of http requests, including the transfer of the response.");
+	alloc_add(&text, "# TYPE prestoclient_http_request_duration_seconds histogram");
+
+	for (i = 0; i < METRICS_METHODCOUNT; i++)
+	{
+		sprintf(label, "method=\"%s\",", metrics_methodnames[i]);
+		metrics_print_histogram(&text, "prestoclient_http_request_duration_seconds", label, &snapshot.requesttime[i]);
+	}
+
+	alloc_add(&text, "# HELP prestoclient_rows_total Rows received by finished queries.");
+	alloc_add(&text, "# TYPE prestoclient_rows_total counter");
+	sprintf(line, "prestoclient_rows_total %llu", snapshot.rows);
+	alloc_add(&text, line);
+
+	alloc_add(&text, "# HELP prestoclient_received_bytes_total Bytes of response data received by finished queries.");
+	alloc_add(&text, "# TYPE prestoclient_received_bytes_total counter");
+	sprintf(line, "prestoclient_received_bytes_total %llu", snapshot.bytes);
+	alloc_add(&text, line);
+
+	// alloc_add separates lines with a newline, this adds the final one
+	alloc_add(&text, "");
+
+	// Like snprintf: copy what fits and return the length of the complete text
+	length = (unsigned int)strlen(text);
+
+	if (buffer && buffersize > 0)
+	{
+		strncpy(buffer, text, buffersize - 1);
+		buffer[buffersize - 1] = 0;
+	}
+
+	free(text);
+
+	return length;
+}
@@ -0,0 +1,193 @@
+/*
+* This file is part of cPrestoClient
+*
+* Copyright (C) 2014 Ivo Herweijer
+*
+* cPrestoClient is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+* You can contact me via email: info@easydatawarehousing.com
+*/
+
+// Trace points for the hot paths of prestoclient (http requests, json parsing, callbacks). Every thread records
+// its events in its own ring buffer, so recording needs no locks. The buffers are written as a Chrome trace-event
+// json file that can be loaded in chrome://tracing or https://ui.perfetto.dev
+// Only compiled in when PRESTOCLIENT_TRACE is defined, otherwise the trace functions do nothing.
+
+#include "prestoclient.h"
+#include "prestoclienttypes.h"
+
+#ifdef PRESTOCLIENT_TRACE
+
+#ifdef _WIN32
+#include <windows.h>
+#define TRACE_THREADLOCAL					__declspec(thread)
+#define TRACE_ATOMIC_INCREMENT(var)			InterlockedIncrement(var)
+#define TRACE_ATOMIC_PUSH(head, item)		(InterlockedCompareExchangePointer( (PVOID volatile*)(head), (item), (item)->next) == (item)->next)
+#else
+#define TRACE_THREADLOCAL					__thread
+#define TRACE_ATOMIC_INCREMENT(var)			__sync_add_and_fetch(var, 1)
+#define TRACE_ATOMIC_PUSH(head, item)		__sync_bool_compare_and_swap(head, (item)->next, item)
+#endif
+
+/* --- Structs -------------------------------------------------------------------------------------------------------- */
+typedef struct ST_TRACEEVENT
+{
+	const char					 *name;							// Name of the trace point, must be a static string
+	const char					 *argname;						// Name of the argument or NULL if there is none
+	double						  starttime;					// Start of the event in seconds
+	double						  duration;						// Duration of the event in seconds
+	unsigned long long			  arg;							// Argument value
+} TRACEEVENT;
+
+typedef struct ST_TRACEBUFFER
+{
+	struct ST_TRACEBUFFER		 *next;							// Next buffer in the list of all threads
+	long						  threadid;						// Sequence number of the thread, starting at 1
+	unsigned long long			  eventcount;					// Number of events recorded, only written by the owning thread
+	TRACEEVENT					  events[PRESTOCLIENT_TRACE_BUFFERSIZE];	// Ring buffer with the last recorded events
+} TRACEBUFFER;
+
+/* --- Globals -------------------------------------------------------------------------------------------------------- */
+volatile int								 trace_enabled = 0;			// Runtime switch, checked by every trace point
+static double								 trace_epoch = 0.0;			// Time tracing was first enabled, events are relative to this
+static TRACEBUFFER * volatile				 trace_buffers = NULL;		// List of the buffers of all threads
+static volatile long						 trace_threadcount = 0;		// Number of buffers created
+static TRACE_THREADLOCAL TRACEBUFFER		*trace_threadbuffer = NULL;	// Buffer of the current thread
+
+/* --- Private functions ---------------------------------------------------------------------------------------------- */
+static TRACEBUFFER* trace_getbuffer()
+{
+	TRACEBUFFER *buffer = trace_threadbuffer;
+
+	if (buffer)
+		return buffer;
+
+	// Buffers are never freed, so a dump still contains the events of threads that have finished
+	buffer = (TRACEBUFFER*)calloc(1, sizeof(TRACEBUFFER) );
+
+	if (!buffer)
+		exit(1);
+
+	buffer->threadid = TRACE_ATOMIC_INCREMENT(&trace_threadcount);
+
+	do
+	{
+		buffer->next = trace_buffers;
+	} while (!TRACE_ATOMIC_PUSH(&trace_buffers, buffer) );
+
+	trace_threadbuffer = buffer;
+
+	return buffer;
+}
+
+static void trace_writeevent(FILE *file, const TRACEBUFFER *buffer, const TRACEEVENT *event, bool *first)
+{
+	fprintf(file, "%s\n{\"name\":\"%s\",\"cat\":\"prestoclient\",\"ph\":\"X\",\"pid\":1,\"tid\":%ld,\"ts\":%.3f,\"dur\":%.3f",
+			*first ? "" : ",",
+			event->name,
+			buffer->threadid,
+			(event->starttime - trace_epoch) * 1e6,
+			event->duration * 1e6);
+
+	if (event->argname)
+		fprintf(file, ",\"args\":{\"%s\":%llu}", event->argname, event->arg);
+
+	fprintf(file, "}");
+
+	*first = false;
+}
+
+/* --- Public functions ----------------------------------------------------------------------------------------------- */
+void trace_end(double starttime, const char *name, const char *argname, unsigned long long arg)
+{
+	TRACEBUFFER *buffer;
+	TRACEEVENT *event;
+
+	buffer = trace_getbuffer();
+	event  = &buffer->events[buffer->eventcount % PRESTOCLIENT_TRACE_BUFFERSIZE];
+
+	event->name      = name;
+	event->argname   = argname;
+	event->starttime = starttime;
+	event->duration  = util_gettime() - starttime;
+	event->arg       = arg;
+
+	buffer->eventcount++;
+}
+
+int prestoclient_settrace(int enabled)
+{
+	if (enabled && trace_epoch == 0.0)
+		trace_epoch = util_gettime();
+
+	trace_enabled = enabled ? 1 : 0;
+
+	return true;
+}
+
+int prestoclient_writetrace(const char *filename)
+{
+	FILE *file;
+	TRACEBUFFER *buffer;
+	unsigned long long i, first;
+	bool firstevent = true;
+
+	if (!filename)
+		return false;
+
+	file = fopen(filename, "w");
+
+	if (!file)
+		return false;
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+	for (buffer = trace_buffers; buffer; buffer = buffer->next)
+	{
+		fprintf(file, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%ld,\"args\":{\"name\":\"prestoclient thread %ld\"}}",
+				firstevent ? "" : ",",
+				buffer->threadid,
+				buffer->threadid);
+
+		firstevent = false;
+
+		// When the ring buffer wrapped around only the last events are available
+		first = buffer->eventcount > PRESTOCLIENT_TRACE_BUFFERSIZE ? buffer->eventcount - PRESTOCLIENT_TRACE_BUFFERSIZE : 0;
+
+		for (i = first; i < buffer->eventcount; i++)
+			trace_writeevent(file, buffer, &buffer->events[i % PRESTOCLIENT_TRACE_BUFFERSIZE], &firstevent);
+	}
+
+	fprintf(file, "\n]}\n");
+
+	return fclose(file) == 0;
+}
+
+#else
+
+int prestoclient_settrace(int enabled)
+{
+	(void)enabled;
+
+	return false;
+}
+
+int prestoclient_writetrace(const char *filename)
+{
+	(void)filename;
+
+	return false;
+}
+
+#endif // PRESTOCLIENT_TRACE
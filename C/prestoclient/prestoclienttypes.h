@@ -37,6 +37,19 @@
 #define PRESTOCLIENT_CURL_EXPECT_HTTP_GET_POST 200;			// Expected http response code for get and post requests
 #define PRESTOCLIENT_CURL_EXPECT_HTTP_DELETE   204;			// Expected http response code for delete requests
 #define PRESTOCLIENT_CURL_EXPECT_HTTP_BUSY     503;			// Expected http response code when presto server is busy
+#define PRESTOCLIENT_TRACE_BUFFERSIZE 16384					// Number of trace events kept per thread
+
+// Trace points, compiled in when PRESTOCLIENT_TRACE is defined. When tracing is switched off at runtime
+// a trace point costs one test of trace_enabled. TRACE_DECLARE must be the last declaration of a block.
+#ifdef PRESTOCLIENT_TRACE
+#define TRACE_DECLARE(var)					double var = 0.0
+#define TRACE_BEGIN(var)					var = trace_enabled ? util_gettime() : 0.0
+#define TRACE_END(var, name, argname, arg)	do { if (var != 0.0) trace_end(var, name, argname, arg); } while (0)
+#else
+#define TRACE_DECLARE(var)
+#define TRACE_BEGIN(var)
+#define TRACE_END(var, name, argname, arg)
+#endif
 
 /* --- Enums ---------------------------------------------------------------------------------------------------------- */
 enum E_RESULTCODES
@@ -46,7 +59,8 @@ enum E_RESULTCODES
 	PRESTOCLIENT_RESULT_SERVER_ERROR,
 	PRESTOCLIENT_RESULT_MAX_RETRIES_REACHED,
 	PRESTOCLIENT_RESULT_CURL_ERROR,
-	PRESTOCLIENT_RESULT_PARSE_JSON_ERROR
+	PRESTOCLIENT_RESULT_PARSE_JSON_ERROR,
+	PRESTOCLIENT_RESULT_CANCELLED
 };
 
 enum E_HTTP_REQUEST_TYPES
@@ -132,6 +146,10 @@ typedef struct ST_JSONLEXER
 	char						 *value;						// Last found value string
 	unsigned int				  valuesize;					// Maximum length of value
 	unsigned int				  valueactualsize;				// Actual length of value
+	char						 *nested;						// Compact json text of the array, map or row value being read
+	unsigned int				  nestedsize;					// Maximum length of nested
+	unsigned int				  nestedactualsize;				// Actual length of nested
+	unsigned int				  nesteddepth;					// Size of tagorder when the nested value started, 0 when not reading one
 
 } JSONLEXER;
 
@@ -139,9 +157,12 @@ typedef struct ST_PRESTOCLIENT_FIELD
 {
 	char						 *name;							// Name of column
 	enum E_FIELDTYPES			  type;							// Type of field
+	char						 *servertype;					// Type as sent by the server, for example varchar(10)
 	char						 *data;							// Buffer for fielddata
 	unsigned int				  datasize;						// Size of data buffer
+	unsigned int				  datalength;					// Length of the string in data
 	bool						  dataisnull;					// Set to true if content of data is null
+	bool						  dataisstring;					// Set to true if data was sent as a json string
 } PRESTOCLIENT_FIELD;
 
 typedef struct ST_PRESTOCLIENT PRESTOCLIENT;
@@ -150,17 +171,20 @@ typedef struct ST_PRESTOCLIENT_RESULT
 {
 	PRESTOCLIENT				 *client;						// Pointer to PRESTOCLIENT
 	CURL						 *hcurl;						// Handle to libCurl
+	CURLM						 *hmulti;						// Multi handle used to run requests that can be cancelled
 	char						 *curl_error_buffer;			// Buffer for storing curl error messages
 	void (*write_callback_function)(void*, void*);				// Functionpointer to client function handling queryoutput
 	void (*describe_callback_function)(void*, void*);			// Functionpointer to client function handling output description
+	void (*progress_callback_function)(void*, void*);			// Functionpointer to client function called after every response
 	void						 *client_object;				// Pointer to object to pass to client function
 	char						 *lastinfouri;					// Uri to query information on the Presto server
 	char						 *lastnexturi;					// Uri to next dataframe on the Presto server
 	char						 *lastcanceluri;				// Uri to cancel query on the Presto server
 	char						 *laststate;					// State returned by last request to Presto server
 	char						 *lasterrormessage;				// Last error message returned by Presto server
+	char						 *lastservermessage;			// Message of the last error, without the exception type
 	enum E_CLIENTSTATUS			  clientstatus;					// Status defined by PrestoClient: NONE, RUNNING, SUCCEEDED, FAILED
-	bool						  cancelquery;					// Boolean, when set to true signals that query should be cancelled
+	void						 *cancelevent;					// Event, when set signals that query should be cancelled. May be set by another thread
 	char						 *lastresponse;					// Buffer for curl response
 	size_t						  lastresponsebuffersize;		// Maximum size of the curl buffer
 	size_t						  lastresponseactualsize;		// Actual size of the curl buffer
@@ -173,6 +197,8 @@ typedef struct ST_PRESTOCLIENT_RESULT
 	enum E_RESULTCODES			  errorcode;					// Errorcode, set when terminating a request
 	JSONPARSER					 *json;							// Pointer to the json parser
 	JSONLEXER					 *lexer;						// Pointer to the json lexer
+	PRESTOCLIENT_STATS			  stats;						// Transfer statistics
+	PRESTOCLIENT_SERVERSTATS	  serverstats;					// Query statistics reported by the server
 } PRESTOCLIENT_RESULT;
 
 typedef struct ST_PRESTOCLIENT
@@ -186,6 +212,8 @@ typedef struct ST_PRESTOCLIENT
 	char						 *language;						// Language to pass to Presto server
 	PRESTOCLIENT_RESULT			**results;						// Array containing query status and data
 	unsigned int				  active_results;				// Number of queries issued
+	void						 *resultslock;					// Mutex protecting results and active_results, queries may run in several threads
+	void (*progress_callback_function)(void*, void*);			// Progress callback for new queries
 } PRESTOCLIENT;
 
 /* --- Functions ------------------------------------------------------------------------------------------------------ */
@@ -193,11 +221,40 @@ typedef struct ST_PRESTOCLIENT
 // Utility functions
 extern char* get_username();
 extern void util_sleep(const int sleeptime_msec);
+extern double util_gettime();
+extern unsigned long long util_atomic_add(volatile unsigned long long *var, unsigned long long value);
+extern unsigned long long util_atomic_load(volatile unsigned long long *var);
+extern void* util_new_mutex();
+extern void util_delete_mutex(void *mutex);
+extern void util_lock(void *mutex);
+extern void util_unlock(void *mutex);
+extern void util_curl_global_init();
+extern void* util_new_event();
+extern void util_delete_event(void *event);
+extern void util_set_event(void *event);
+extern int util_wait_event(void *event, const int waittime_msec);
+extern int util_isset_event(void *event);
 
 // Memory handling functions
 extern void alloc_copy(char **var, const char *newvalue);
 extern void alloc_add(char **var, const char *addedvalue);
 extern PRESTOCLIENT_FIELD* new_prestofield();
+extern PRESTOCLIENT_RESULT* new_prestoresult();
+extern void delete_prestoresult(PRESTOCLIENT_RESULT* result);
+
+// Curl functions (also called directly by the benchmark tools)
+extern size_t WriteCallback(void *contents, size_t size, size_t nmemb, void *userp);
+
+// Trace functions
+#ifdef PRESTOCLIENT_TRACE
+extern volatile int trace_enabled;
+extern void trace_end(double starttime, const char *name, const char *argname, unsigned long long arg);
+#endif
+
+// Metrics functions
+extern void metrics_add_request(enum E_HTTP_REQUEST_TYPES request_type, double seconds, bool busy, bool error, bool cancelled);
+extern void metrics_start_query();
+extern void metrics_end_query(PRESTOCLIENT_RESULT *result, double seconds);
 
 // JSON Functions
 extern bool json_reader(PRESTOCLIENT_RESULT* result);
@@ -19,10 +19,14 @@
 * You can contact me via email: info@easydatawarehousing.com
 */
 
+#include <curl/curl.h>
+
 #ifdef _WIN32
 #include <windows.h>
 #include <Lmcons.h>
 
+static INIT_ONCE curl_init_once = INIT_ONCE_STATIC_INIT;
+
 // returnvalue must be freed by caller
 char* get_username()
 {
@@ -41,26 +45,307 @@ void util_sleep(const int sleeptime_msec)
 {
 	Sleep(sleeptime_msec);
 }
+
+// Monotonic timestamp in seconds, used for statistics
+double util_gettime()
+{
+	LARGE_INTEGER frequency, counter;
+
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+
+	return (double)counter.QuadPart / (double)frequency.QuadPart;
+}
+
+// Add value to var as one atomic operation, returns the new value
+unsigned long long util_atomic_add(volatile unsigned long long *var, unsigned long long value)
+{
+	return (unsigned long long)InterlockedExchangeAdd64( (volatile LONGLONG*)var, (LONGLONG)value) + value;
+}
+
+// Read var as one atomic operation, also on 32 bit systems. Acts as a full memory barrier
+unsigned long long util_atomic_load(volatile unsigned long long *var)
+{
+	return (unsigned long long)InterlockedCompareExchange64( (volatile LONGLONG*)var, 0, 0);
+}
+
+// returnvalue must be freed with util_delete_mutex
+void* util_new_mutex()
+{
+	CRITICAL_SECTION *mutex = (CRITICAL_SECTION*)malloc(sizeof(CRITICAL_SECTION) );
+
+	if (!mutex)
+		exit(1);
+
+	InitializeCriticalSection(mutex);
+
+	return (void*)mutex;
+}
+
+void util_delete_mutex(void *mutex)
+{
+	DeleteCriticalSection( (CRITICAL_SECTION*)mutex);
+	free(mutex);
+}
+
+void util_lock(void *mutex)
+{
+	EnterCriticalSection( (CRITICAL_SECTION*)mutex);
+}
+
+void util_unlock(void *mutex)
+{
+	LeaveCriticalSection( (CRITICAL_SECTION*)mutex);
+}
+
+static BOOL CALLBACK util_curl_init(PINIT_ONCE once, PVOID parameter, PVOID *context)
+{
+	(void)once;
+	(void)parameter;
+	(void)context;
+
+	curl_global_init(CURL_GLOBAL_ALL);
+
+	return TRUE;
+}
+
+// curl_global_init is not thread safe, it must run once before any other curl function
+void util_curl_global_init()
+{
+	InitOnceExecuteOnce(&curl_init_once, util_curl_init, NULL, NULL);
+}
+
+// Manual reset event, returnvalue must be freed with util_delete_event
+void* util_new_event()
+{
+	HANDLE event = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+	if (!event)
+		exit(1);
+
+	return (void*)event;
+}
+
+void util_delete_event(void *event)
+{
+	CloseHandle( (HANDLE)event);
+}
+
+void util_set_event(void *event)
+{
+	SetEvent( (HANDLE)event);
+}
+
+// Wait until the event is set or the waittime has passed. Returns true if the event was set
+int util_wait_event(void *event, const int waittime_msec)
+{
+	return WaitForSingleObject( (HANDLE)event, (DWORD)waittime_msec) == WAIT_OBJECT_0;
+}
+
+int util_isset_event(void *event)
+{
+	return WaitForSingleObject( (HANDLE)event, 0) == WAIT_OBJECT_0;
+}
 #else
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <pwd.h>
+#include <pthread.h>
+
+static pthread_once_t curl_init_once = PTHREAD_ONCE_INIT;
 
 // returnvalue must be freed by caller
 char* get_username()
 {
-	char *username = (char*)calloc(strlen(getenv("USER") ) + 1, sizeof(char) );
+	const char *name = getenv("USER");
+	char *username, buffer[1024];
+	struct passwd password, *entry = NULL;
+
+	// USER is often not set for daemons and in containers, use the name of the effective user id instead
+	if (!name || strlen(name) == 0)
+	{
+		if (getpwuid_r(geteuid(), &password, buffer, sizeof(buffer), &entry) == 0 && entry)
+			name = entry->pw_name;
+		else
+			name = "prestoclient";
+	}
+
+	username = (char*)calloc(strlen(name) + 1, sizeof(char) );
 
 	if (!username)
 		exit(1);
 
-	strcpy(username, getenv("USER") );
+	strcpy(username, name);
 
 	return username;
 }
 
 void util_sleep(const int sleeptime_msec)
 {
-	sleep(sleeptime_msec / 1000);
+	struct timespec waittime;
+
+	waittime.tv_sec  = sleeptime_msec / 1000;
+	waittime.tv_nsec = (sleeptime_msec % 1000) * 1000000L;
+
+	while (nanosleep(&waittime, &waittime) != 0 && errno == EINTR)
+		;
+}
+
+// Monotonic timestamp in seconds, used for statistics
+double util_gettime()
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+// Add value to var as one atomic operation, returns the new value
+unsigned long long util_atomic_add(volatile unsigned long long *var, unsigned long long value)
+{
+	return __sync_add_and_fetch(var, value);
+}
+
+// Read var as one atomic operation, also on 32 bit systems. Acts as a full memory barrier
+unsigned long long util_atomic_load(volatile unsigned long long *var)
+{
+	return __sync_add_and_fetch(var, 0);
+}
+
+// returnvalue must be freed with util_delete_mutex
+void* util_new_mutex()
+{
+	pthread_mutex_t *mutex = (pthread_mutex_t*)malloc(sizeof(pthread_mutex_t) );
+
+	if (!mutex)
+		exit(1);
+
+	pthread_mutex_init(mutex, NULL);
+
+	return (void*)mutex;
+}
+
+void util_delete_mutex(void *mutex)
+{
+	pthread_mutex_destroy( (pthread_mutex_t*)mutex);
+	free(mutex);
+}
+
+void util_lock(void *mutex)
+{
+	pthread_mutex_lock( (pthread_mutex_t*)mutex);
+}
+
+void util_unlock(void *mutex)
+{
+	pthread_mutex_unlock( (pthread_mutex_t*)mutex);
+}
+
+static void util_curl_init()
+{
+	curl_global_init(CURL_GLOBAL_ALL);
+}
+
+// curl_global_init is not thread safe, it must run once before any other curl function
+void util_curl_global_init()
+{
+	pthread_once(&curl_init_once, util_curl_init);
+}
+
+// Manual reset event: once set it stays set
+typedef struct ST_UTIL_EVENT
+{
+	pthread_mutex_t				  mutex;
+	pthread_cond_t				  cond;
+	int							  isset;
+} UTIL_EVENT;
+
+// returnvalue must be freed with util_delete_event
+void* util_new_event()
+{
+	UTIL_EVENT *event = (UTIL_EVENT*)malloc(sizeof(UTIL_EVENT) );
+	pthread_condattr_t attr;
+
+	if (!event)
+		exit(1);
+
+	pthread_condattr_init(&attr);
+#ifndef __APPLE__
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+#endif
+	pthread_mutex_init(&event->mutex, NULL);
+	pthread_cond_init(&event->cond, &attr);
+	pthread_condattr_destroy(&attr);
+	event->isset = 0;
+
+	return (void*)event;
+}
+
+void util_delete_event(void *event)
+{
+	pthread_cond_destroy( &( (UTIL_EVENT*)event)->cond);
+	pthread_mutex_destroy( &( (UTIL_EVENT*)event)->mutex);
+	free(event);
+}
+
+void util_set_event(void *in_event)
+{
+	UTIL_EVENT *event = (UTIL_EVENT*)in_event;
+
+	pthread_mutex_lock(&event->mutex);
+	event->isset = 1;
+	pthread_cond_broadcast(&event->cond);
+	pthread_mutex_unlock(&event->mutex);
+}
+
+// Wait until the event is set or the waittime has passed. Returns true if the event was set
+int util_wait_event(void *in_event, const int waittime_msec)
+{
+	UTIL_EVENT *event = (UTIL_EVENT*)in_event;
+	struct timespec until;
+	int isset;
+
+#ifdef __APPLE__
+	clock_gettime(CLOCK_REALTIME, &until);
+#else
+	clock_gettime(CLOCK_MONOTONIC, &until);
+#endif
+	until.tv_sec  += waittime_msec / 1000;
+	until.tv_nsec += (waittime_msec % 1000) * 1000000L;
+
+	if (until.tv_nsec >= 1000000000L)
+	{
+		until.tv_sec++;
+		until.tv_nsec -= 1000000000L;
+	}
+
+	pthread_mutex_lock(&event->mutex);
+
+	while (!event->isset)
+	{
+		if (pthread_cond_timedwait(&event->cond, &event->mutex, &until) != 0)
+			break;
+	}
+
+	isset = event->isset;
+	pthread_mutex_unlock(&event->mutex);
+
+	return isset;
+}
+
+int util_isset_event(void *in_event)
+{
+	UTIL_EVENT *event = (UTIL_EVENT*)in_event;
+	int isset;
+
+	pthread_mutex_lock(&event->mutex);
+	isset = event->isset;
+	pthread_mutex_unlock(&event->mutex);
+
+	return isset;
 }
 #endif
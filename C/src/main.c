@@ -19,14 +19,17 @@
 */
 
 #include "prestoclient.h"
+#include "outputsink.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 
-#ifndef bool
-#define bool	signed char
-#define true	1
-#define false	0
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
 #endif
 
 /*
@@ -37,10 +40,93 @@
 typedef struct ST_QUERYDATA
 {
 	bool			 hdr_printed;
-	char 			*cache;
-	unsigned int 	 cache_size;
+	OUTPUTSINK		*sink;
+	char			**jsonprefix;		/* Per column: separator and quoted column name, used for jsonl output */
+	unsigned int	*jsonprefixlength;
+	unsigned int	 jsoncolumncount;
+	double			 starttime;			/* Start of query, used for benchmark output */
+	double			 firstrowtime;		/* Time the first row was received or zero */
+	unsigned long long rows;			/* Rows seen by the count sink */
+	unsigned long long cells;			/* Cells seen by the count sink */
+	unsigned long long valuebytes;		/* Total length of all values seen by the count sink */
+	bool			 progress;			/* Show a progress bar on stderr */
+	bool			 progressshown;		/* Progress bar has been printed */
+	double			 timeout;			/* Cancel the query after this number of seconds, zero for no timeout */
+	bool			 timedout;			/* Query was cancelled because of the timeout */
+	PRESTOCLIENT_RESULT *result;		/* Handle of the query, known from the first response. Used for the timeout */
+	PRESTOCLIENT	*client;			/* Client running the query, used for the timeout before the first response */
+#ifndef _WIN32
+	pthread_t		 timer;				/* Cancels the query when the timeout has passed */
+	pthread_mutex_t	 timerlock;			/* Protects timedout, result and finished */
+	pthread_cond_t	 timercond;
+	bool			 finished;			/* prestoclient_query returned, the timer thread can stop */
+#endif
 } QUERYDATA;
 
+#define PROGRESS_BARWIDTH 30
+
+/*
+ * Supported output formats
+ */
+enum E_OUTPUTFORMAT
+{
+	OUTPUT_FORMAT_CSV = 0,
+	OUTPUT_FORMAT_JSONL
+};
+
+/*
+ * Where output goes: formatted to stdout or a file, or only counted for benchmarking
+ */
+enum E_SINKTYPE
+{
+	SINK_TYPE_OUTPUT = 0,
+	SINK_TYPE_COUNT,			/* Visit every value but don't format anything */
+	SINK_TYPE_DISCARD			/* Don't look at the data at all */
+};
+
+/*
+ * Commandline options
+ */
+typedef struct ST_OPTIONS
+{
+	char				*server;
+	unsigned int		 port;
+	char				*sql;
+	char				*outputfile;
+	size_t				 blocksize;
+	bool				 directio;
+	bool				 dropcache;
+	enum E_FSYNCPOLICY	 fsyncpolicy;
+	enum E_OUTPUTFORMAT	 format;
+	enum E_SINKTYPE		 sinktype;
+	bool				 stats;
+	bool				 progress;
+	double				 timeout;
+	char				*tracefile;
+	bool				 metrics;
+} OPTIONS;
+
+/*
+ * Return a timestamp in seconds, used to measure throughput
+ */
+static double get_time()
+{
+#ifdef _WIN32
+	LARGE_INTEGER frequency, counter;
+
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+
+	return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+#endif
+}
+
 /*
  * The descibe callback function. This function will be called when the
  * column description data becomes available. You can use it to print header
@@ -58,17 +144,27 @@ static void describe_callback_function(void *in_querydata, void *in_result)
 		 * Print header row
 		 */
 		for (i = 0; i < columncount; i++)
-			printf("%s%s", i > 0 ? ";" : "", prestoclient_getcolumnname(result, i) );
+		{
+			if (i > 0)
+				outputsink_write(qdata->sink, ";", 1);
+
+			outputsink_writestring(qdata->sink, prestoclient_getcolumnname(result, i) );
+		}
 
-		printf("\n");
+		outputsink_write(qdata->sink, "\n", 1);
 
 		/*
 		 * Print datatype of each column
 		 */
 		for (i = 0; i < columncount; i++)
-			printf("%s%s", i > 0 ? ";" : "", prestoclient_getcolumntypedescription(result, i) );
+		{
+			if (i > 0)
+				outputsink_write(qdata->sink, ";", 1);
+
+			outputsink_writestring(qdata->sink, prestoclient_getcolumntypedescription(result, i) );
+		}
 
-		printf("\n");
+		outputsink_write(qdata->sink, "\n", 1);
 		
 		/*
 		 * Mark header as printed
@@ -85,33 +181,18 @@ static void write_callback_function(void *in_querydata, void *in_result)
 {
 	QUERYDATA			*qdata  = (QUERYDATA*)in_querydata;
 	PRESTOCLIENT_RESULT	*result = (PRESTOCLIENT_RESULT*)in_result;
-	unsigned int		 i, newdatalen, columncount = prestoclient_getcolumncount(result);
+	unsigned int		 i, columncount = prestoclient_getcolumncount(result);
 
 	/*
-	 * Output one data row
+	 * Output one data row. Values are appended to the output buffer directly,
+	 * the sink takes care of writing large blocks
 	 */
 	for (i = 0; i < columncount; i++)
 	{
-		/*
-		 * Check cache size first
-		 */
-		newdatalen = strlen(prestoclient_getcolumndata(result, i) );
-
-		if (qdata->cache_size < strlen(qdata->cache) + newdatalen + 3)
-		{
-			/*
-			 * Add memory block of 1 Kb to cache
-			 */
-			qdata->cache_size = ( (qdata->cache_size + newdatalen + 1027) / 1024) * 1024;
-			qdata->cache = (char*)realloc( (char*)qdata->cache, qdata->cache_size);
-			if (!qdata->cache)
-				exit(1);
-		}
-
 		/*
 		 * Add field value as string, prestoclient doesn't do any type conversions (yet)
 		 */
-		strcat(qdata->cache, prestoclient_getcolumndata(result, i) );
+		outputsink_write(qdata->sink, prestoclient_getcolumndata(result, i), prestoclient_getcolumndatalength(result, i) );
 
 		/*
 		 * You can use prestoclient_getnullcolumnvalue here
@@ -122,18 +203,401 @@ static void write_callback_function(void *in_querydata, void *in_result)
 		 * Add a field separator
 		 */
 		if (i < columncount - 1)
-			strcat(qdata->cache, ";");
+			outputsink_write(qdata->sink, ";", 1);
 	}
 
 	/*
-	 * Print rowdata and a row separator
+	 * Add a row separator
 	 */
-	printf("%s\n", qdata->cache);
+	outputsink_write(qdata->sink, "\n", 1);
+}
+
+/*
+ * The describe callback function for json lines output. Instead of printing a
+ * header the text preceding every value is prepared: {"name": for the first
+ * column and ,"name": for the others. Column names are used as sent by the
+ * server, so they are still json escaped.
+ */
+static void describe_callback_jsonl(void *in_querydata, void *in_result)
+{
+	QUERYDATA			*qdata  = (QUERYDATA*)in_querydata;
+	PRESTOCLIENT_RESULT	*result = (PRESTOCLIENT_RESULT*)in_result;
+	unsigned int		 i, columncount = prestoclient_getcolumncount(result);
+	char				*name;
+
+	if (qdata->hdr_printed || columncount == 0)
+		return;
+
+	qdata->jsonprefix       = (char**)malloc(columncount * sizeof(char*) );
+	qdata->jsonprefixlength = (unsigned int*)malloc(columncount * sizeof(unsigned int) );
+
+	if (!qdata->jsonprefix || !qdata->jsonprefixlength)
+		exit(1);
+
+	for (i = 0; i < columncount; i++)
+	{
+		name = prestoclient_getcolumnname(result, i);
+
+		qdata->jsonprefix[i] = (char*)malloc(strlen(name) + 5);
+		if (!qdata->jsonprefix[i])
+			exit(1);
+
+		sprintf(qdata->jsonprefix[i], "%s\"%s\":", i == 0 ? "{" : ",", name);
+		qdata->jsonprefixlength[i] = (unsigned int)strlen(qdata->jsonprefix[i]);
+	}
+
+	qdata->jsoncolumncount = columncount;
+	qdata->hdr_printed     = true;
+}
+
+/*
+ * The write callback function for json lines output. Every row becomes one
+ * json object. Values are passed through exactly as the server sent them.
+ */
+static void write_callback_jsonl(void *in_querydata, void *in_result)
+{
+	QUERYDATA			*qdata  = (QUERYDATA*)in_querydata;
+	PRESTOCLIENT_RESULT	*result = (PRESTOCLIENT_RESULT*)in_result;
+	unsigned int		 i, columncount = qdata->jsoncolumncount;
+
+	if (columncount == 0)
+		return;
+
+	for (i = 0; i < columncount; i++)
+	{
+		outputsink_write(qdata->sink, qdata->jsonprefix[i], qdata->jsonprefixlength[i]);
+
+		if (prestoclient_getnullcolumnvalue(result, i) )
+		{
+			outputsink_write(qdata->sink, "null", 4);
+		}
+		else if (prestoclient_getcolumndataisstring(result, i) )
+		{
+			outputsink_write(qdata->sink, "\"", 1);
+			outputsink_write(qdata->sink, prestoclient_getcolumndata(result, i), prestoclient_getcolumndatalength(result, i) );
+			outputsink_write(qdata->sink, "\"", 1);
+		}
+		else if (prestoclient_getcolumntype(result, i) == PRESTOCLIENT_TYPE_BOOLEAN)
+		{
+			/*
+			 * prestoclient returns booleans as 1 or 0
+			 */
+			if (prestoclient_getcolumndata(result, i)[0] == '1')
+				outputsink_write(qdata->sink, "true", 4);
+			else
+				outputsink_write(qdata->sink, "false", 5);
+		}
+		else
+		{
+			outputsink_write(qdata->sink, prestoclient_getcolumndata(result, i), prestoclient_getcolumndatalength(result, i) );
+		}
+	}
+
+	outputsink_write(qdata->sink, "}\n", 2);
+}
+
+/*
+ * Write callback function for the count sink. Looks at every value, like a real
+ * consumer would, without formatting any output.
+ */
+static void write_callback_count(void *in_querydata, void *in_result)
+{
+	QUERYDATA			*qdata  = (QUERYDATA*)in_querydata;
+	PRESTOCLIENT_RESULT	*result = (PRESTOCLIENT_RESULT*)in_result;
+	unsigned int		 i, columncount = prestoclient_getcolumncount(result);
+
+	if (qdata->rows == 0)
+		qdata->firstrowtime = get_time();
+
+	for (i = 0; i < columncount; i++)
+		qdata->valuebytes += prestoclient_getcolumndatalength(result, i);
+
+	qdata->cells += columncount;
+	qdata->rows++;
+}
+
+/*
+ * Write callback function for the discard sink. Only notes when the first row arrives.
+ */
+static void write_callback_discard(void *in_querydata, void *in_result)
+{
+	QUERYDATA *qdata = (QUERYDATA*)in_querydata;
+
+	(void)in_result;
+
+	if (qdata->firstrowtime == 0.0)
+		qdata->firstrowtime = get_time();
+}
+
+#ifndef _WIN32
+/*
+ * Timer thread. Cancels the query when the timeout has passed, also while the client is waiting for a
+ * slow response of the server. When the handle of the query isn't known yet, because the server hasn't
+ * answered the request that starts the query, all queries of the client are cancelled.
+ */
+static void* timeout_thread(void *in_querydata)
+{
+	QUERYDATA		*qdata = (QUERYDATA*)in_querydata;
+	struct timespec	 deadline;
+	int				 status = 0;
+
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec  += (time_t)qdata->timeout;
+	deadline.tv_nsec += (long)( (qdata->timeout - (double)(time_t)qdata->timeout) * 1e9);
+
+	if (deadline.tv_nsec >= 1000000000L)
+	{
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000L;
+	}
+
+	pthread_mutex_lock(&qdata->timerlock);
+
+	while (!qdata->finished && status != ETIMEDOUT)
+		status = pthread_cond_timedwait(&qdata->timercond, &qdata->timerlock, &deadline);
+
+	if (!qdata->finished)
+	{
+		qdata->timedout = true;
+
+		if (qdata->result)
+			prestoclient_cancelquery(qdata->result);
+		else
+			prestoclient_cancelqueries(qdata->client);
+	}
+
+	pthread_mutex_unlock(&qdata->timerlock);
+
+	return NULL;
+}
+#endif
+
+/*
+ * Check the timeout. The timer thread does the actual check, this passes it the handle of the query.
+ * Without threads (Windows) the timeout is checked after every response.
+ */
+static void check_timeout(QUERYDATA *qdata, PRESTOCLIENT_RESULT *result)
+{
+#ifndef _WIN32
+	bool timedout;
+
+	pthread_mutex_lock(&qdata->timerlock);
+	qdata->result = result;
+	timedout      = qdata->timedout;
+	pthread_mutex_unlock(&qdata->timerlock);
+
+	if (timedout)
+		prestoclient_cancelquery(result);
+#else
+	if (!qdata->timedout && get_time() - qdata->starttime > qdata->timeout)
+	{
+		qdata->timedout = true;
+		prestoclient_cancelquery(result);
+	}
+#endif
+}
+
+/*
+ * Progress callback function. Called after every response of the server, also while the query is
+ * queued. Shows a progress bar on stderr and cancels the query when it takes too long.
+ */
+static void progress_callback(void *in_querydata, void *in_result)
+{
+	QUERYDATA					*qdata  = (QUERYDATA*)in_querydata;
+	PRESTOCLIENT_RESULT			*result = (PRESTOCLIENT_RESULT*)in_result;
+	PRESTOCLIENT_SERVERSTATS	 stats;
+	char						 bar[PROGRESS_BARWIDTH + 1];
+	const char					*state;
+	double						 progress, timeleft;
+	unsigned int				 i, filled, seconds;
+
+	if (qdata->timeout > 0.0)
+		check_timeout(qdata, result);
+
+	if (!qdata->progress || !prestoclient_getserverstats(result, &stats) )
+		return;
+
+	progress = prestoclient_getprogress(result);
+	timeleft = prestoclient_getestimatedtimeleft(result);
+	state    = prestoclient_getlastserverstate(result);
+	filled   = progress > 0.0 ? (unsigned int)(progress * PROGRESS_BARWIDTH / 100.0) : 0;
+
+	for (i = 0; i < PROGRESS_BARWIDTH; i++)
+		bar[i] = i < filled ? '#' : '.';
+
+	bar[PROGRESS_BARWIDTH] = 0;
+
+	fprintf(stderr, "\r[%s] %3.0f%% %-9s %llu/%llu splits %9.1f MB", bar, progress > 0.0 ? progress : 0.0, state ? state : "",
+			stats.completedsplits, stats.totalsplits, (double)stats.processedbytes / (1024.0 * 1024.0) );
+
+	if (timeleft >= 0.0)
+	{
+		seconds = (unsigned int)(timeleft + 0.5);
+		fprintf(stderr, "  ETA %02u:%02u:%02u ", seconds / 3600, (seconds / 60) % 60, seconds % 60);
+	}
+	else
+		fprintf(stderr, "  ETA --:--:-- ");
+
+	fflush(stderr);
+
+	qdata->progressshown = true;
+}
+
+/*
+ * Print throughput information for the count and discard sinks to stderr
+ */
+static void print_benchmark(QUERYDATA *qdata, PRESTOCLIENT_RESULT *result)
+{
+	PRESTOCLIENT_STATS			stats;
+	PRESTOCLIENT_SERVERSTATS	serverstats;
+	double						elapsed = get_time() - qdata->starttime;
+
+	if (!prestoclient_getstats(result, &stats) || !prestoclient_getserverstats(result, &serverstats) )
+		return;
+
+	fprintf(stderr, "Rows:               %llu\n", stats.rows);
+	fprintf(stderr, "Cells:              %llu\n", stats.cells);
+	fprintf(stderr, "Bytes received:     %llu\n", stats.bytes);
+	fprintf(stderr, "Pages:              %llu\n", stats.pages);
+	fprintf(stderr, "Requests:           %llu (%llu retries)\n", stats.requests, stats.retries);
+
+	if (qdata->rows > 0)
+		fprintf(stderr, "Value bytes:        %llu\n", qdata->valuebytes);
+
+	fprintf(stderr, "POST time:          %.3f s\n", stats.posttime);
+	fprintf(stderr, "GET time:           %.3f s (slowest %.3f s)\n", stats.gettime, stats.maxgettime);
+	fprintf(stderr, "Connect time:       %.3f s (name lookup %.3f s)\n", stats.connecttime, stats.namelookuptime);
+	fprintf(stderr, "First byte time:    %.3f s\n", stats.firstbytetime);
+	fprintf(stderr, "Parse time:         %.3f s\n", stats.parsetime);
+	fprintf(stderr, "Callback time:      %.3f s\n", stats.callbacktime);
+	fprintf(stderr, "Wait time:          %.3f s\n", stats.waittime);
+	fprintf(stderr, "Server nodes:       %llu (%llu splits)\n", serverstats.nodes, serverstats.totalsplits);
+	fprintf(stderr, "Server cpu time:    %.3f s (queued %.3f s)\n", serverstats.cputimemillis / 1000.0, serverstats.queuedtimemillis / 1000.0);
+	fprintf(stderr, "Server processed:   %llu rows, %llu bytes\n", serverstats.processedrows, serverstats.processedbytes);
+	fprintf(stderr, "Server peak memory: %llu bytes\n", serverstats.peakmemorybytes);
+
+	if (qdata->firstrowtime > 0.0)
+		fprintf(stderr, "Time to first row:  %.3f s\n", qdata->firstrowtime - qdata->starttime);
+
+	fprintf(stderr, "Elapsed:            %.3f s\n", elapsed);
+
+	if (elapsed > 0.0)
+	{
+		fprintf(stderr, "Rows/sec:           %.0f\n", (double)stats.rows / elapsed);
+		fprintf(stderr, "MB/sec:             %.2f\n", (double)stats.bytes / elapsed / (1024.0 * 1024.0) );
+	}
+}
+
+/*
+ * Print the process wide metrics, as they would be served to a Prometheus scraper
+ */
+static void print_metrics()
+{
+	unsigned int length, size = 0;
+	char *text = NULL;
 
 	/*
-	 * Clear cache
+	 * The text may grow between two calls while other queries are running, so repeat until it fits
 	 */
-	qdata->cache[0] = 0;
+	while ( (length = prestoclient_getmetrics(text, size) ) >= size)
+	{
+		size = length + 1;
+		text = (char*)realloc(text, size);
+
+		if (!text)
+			exit(1);
+	}
+
+	fputs(text, stderr);
+	free(text);
+}
+
+/*
+ * Print usage information
+ */
+static void print_usage()
+{
+	printf("Usage: cprestoclient [options] <servername> <sql-statement>\n");
+	printf("Options:\n");
+	printf("  --port=<n>              TCP port of the Presto server (default %d)\n", PRESTOCLIENT_DEFAULT_PORT);
+	printf("  --format=csv|jsonl      Output format (default csv)\n");
+	printf("  --sink=count|discard    Don't write output, print throughput statistics to stderr\n");
+	printf("  --stats                 Print throughput statistics to stderr\n");
+	printf("  --progress              Show a progress bar on stderr\n");
+	printf("  --timeout=<seconds>     Cancel the query when it takes longer\n");
+	printf("  --trace=<file>          Write a Chrome trace-event timeline of the query to file\n");
+	printf("  --metrics               Print the client metrics in Prometheus text format to stderr\n");
+	printf("  --output=<file>         Write output to file instead of stdout\n");
+	printf("  --blocksize=<kb>        Size of blocks written to the output file (default %d)\n", OUTPUTSINK_FILE_BLOCKSIZE / 1024);
+	printf("  --direct                Open the output file with O_DIRECT\n");
+	printf("  --dropcache             Drop written data from the page cache\n");
+	printf("  --fsync=none|block|end  When to fsync the output file (default none)\n");
+	printf("Example:\ncprestoclient localhost \"select * from sample_07\"\n");
+}
+
+/*
+ * Read commandline parameters. Returns false if they are not valid
+ */
+static bool parse_options(int argc, char **argv, OPTIONS *options)
+{
+	int i;
+
+	memset(options, 0, sizeof(OPTIONS) );
+	options->port        = PRESTOCLIENT_DEFAULT_PORT;
+	options->fsyncpolicy = OUTPUTSINK_FSYNC_NONE;
+	options->format      = OUTPUT_FORMAT_CSV;
+	options->sinktype    = SINK_TYPE_OUTPUT;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (strncmp(argv[i], "--port=", 7) == 0)
+			options->port = (unsigned int)strtoul(argv[i] + 7, NULL, 10);
+		else if (strcmp(argv[i], "--format=csv") == 0)
+			options->format = OUTPUT_FORMAT_CSV;
+		else if (strcmp(argv[i], "--format=jsonl") == 0)
+			options->format = OUTPUT_FORMAT_JSONL;
+		else if (strcmp(argv[i], "--sink=count") == 0)
+			options->sinktype = SINK_TYPE_COUNT;
+		else if (strcmp(argv[i], "--sink=discard") == 0)
+			options->sinktype = SINK_TYPE_DISCARD;
+		else if (strcmp(argv[i], "--stats") == 0)
+			options->stats = true;
+		else if (strcmp(argv[i], "--progress") == 0)
+			options->progress = true;
+		else if (strncmp(argv[i], "--timeout=", 10) == 0)
+			options->timeout = strtod(argv[i] + 10, NULL);
+		else if (strncmp(argv[i], "--trace=", 8) == 0)
+			options->tracefile = argv[i] + 8;
+		else if (strcmp(argv[i], "--metrics") == 0)
+			options->metrics = true;
+		else if (strncmp(argv[i], "--output=", 9) == 0)
+			options->outputfile = argv[i] + 9;
+		else if (strncmp(argv[i], "--blocksize=", 12) == 0)
+			options->blocksize = (size_t)strtoul(argv[i] + 12, NULL, 10) * 1024;
+		else if (strcmp(argv[i], "--direct") == 0)
+			options->directio = true;
+		else if (strcmp(argv[i], "--dropcache") == 0)
+			options->dropcache = true;
+		else if (strcmp(argv[i], "--fsync=none") == 0)
+			options->fsyncpolicy = OUTPUTSINK_FSYNC_NONE;
+		else if (strcmp(argv[i], "--fsync=block") == 0)
+			options->fsyncpolicy = OUTPUTSINK_FSYNC_BLOCK;
+		else if (strcmp(argv[i], "--fsync=end") == 0)
+			options->fsyncpolicy = OUTPUTSINK_FSYNC_END;
+		else if (strncmp(argv[i], "--", 2) == 0)
+		{
+			printf("Unknown option '%s'\n", argv[i]);
+			return false;
+		}
+		else if (!options->server)
+			options->server = argv[i];
+		else if (!options->sql)
+			options->sql = argv[i];
+		else
+			return false;
+	}
+
+	return (options->server && options->sql);
 }
 
 /*
@@ -142,17 +606,21 @@ static void write_callback_function(void *in_querydata, void *in_result)
 int main(int argc, char **argv)
 {
 	QUERYDATA			*qdata;
+	OPTIONS				 options;
 	PRESTOCLIENT		*pc;
 	PRESTOCLIENT_RESULT	*result;
-	bool				 status = false;
+	bool				 status = false, outputok = true;
+	unsigned int		 i;
+	double				 elapsed;
+	void (*write_callback)(void*, void*);
+	void (*describe_callback)(void*, void*);
 
 	/*
 	 * Read commandline parameters
 	 */
-	if (argc < 3)
+	if (!parse_options(argc, argv, &options) )
 	{
-		printf("Usage: cprestoclient <servername> <sql-statement>\n");
-		printf("Example:\ncprestoclient localhost \"select * from sample_07\"\n");
+		print_usage();
 		exit(1);
 	}
 
@@ -161,14 +629,60 @@ int main(int argc, char **argv)
 	 */
 	qdata = (QUERYDATA*)malloc( sizeof(QUERYDATA) );
 	qdata->hdr_printed		= false;
-	qdata->cache_size		= 1;
-	qdata->cache			= (char*)malloc(qdata->cache_size);
-	qdata->cache[0]			= 0;
+	qdata->jsonprefix		= NULL;
+	qdata->jsonprefixlength	= NULL;
+	qdata->jsoncolumncount	= 0;
+	qdata->firstrowtime		= 0.0;
+	qdata->rows				= 0;
+	qdata->cells			= 0;
+	qdata->valuebytes		= 0;
+	qdata->sink				= NULL;
+	qdata->progress			= options.progress;
+	qdata->progressshown	= false;
+	qdata->timeout			= options.timeout;
+	qdata->timedout			= false;
+	qdata->result			= NULL;
+	qdata->client			= NULL;
+
+	if (options.sinktype == SINK_TYPE_COUNT)
+	{
+		write_callback    = &write_callback_count;
+		describe_callback = NULL;
+	}
+	else if (options.sinktype == SINK_TYPE_DISCARD)
+	{
+		write_callback    = &write_callback_discard;
+		describe_callback = NULL;
+	}
+	else if (options.format == OUTPUT_FORMAT_JSONL)
+	{
+		write_callback    = &write_callback_jsonl;
+		describe_callback = &describe_callback_jsonl;
+	}
+	else
+	{
+		write_callback    = &write_callback_function;
+		describe_callback = &describe_callback_function;
+	}
+
+	if (options.sinktype != SINK_TYPE_OUTPUT)
+		qdata->sink = NULL;
+	else if (options.outputfile)
+		qdata->sink = outputsink_open_file(options.outputfile, options.blocksize, options.directio, options.dropcache, options.fsyncpolicy);
+	else
+		qdata->sink = outputsink_open_stdout();
+
+	if (options.sinktype == SINK_TYPE_OUTPUT && !qdata->sink)
+	{
+		printf("Could not open output file '%s'\n", options.outputfile);
+		free(qdata);
+		exit(1);
+	}
 
 	/*
-	 * Initialize prestoclient. We're using default values for everything but the servername
+	 * Initialize prestoclient. We're using default values for everything but the servername and port
 	 */
-	pc = prestoclient_init(argv[1], NULL, NULL, NULL, NULL, NULL, NULL);
+	pc = prestoclient_init(options.server, &options.port, NULL, NULL, NULL, NULL, NULL);
 
 	if (!pc)
 	{
@@ -176,14 +690,79 @@ int main(int argc, char **argv)
 	}
 	else
 	{
+		if (options.progress || options.timeout > 0.0)
+			prestoclient_setprogresscallback(pc, &progress_callback);
+
+		if (options.tracefile && !prestoclient_settrace(true) )
+		{
+			fprintf(stderr, "Tracing is not available, build prestoclient with PRESTOCLIENT_TRACE defined\n");
+			options.tracefile = NULL;
+		}
+
 		/*
 		 * Execute query
 		 */
-		result = prestoclient_query(pc, argv[2], NULL, &write_callback_function, &describe_callback_function, (void*)qdata);
+		qdata->starttime = get_time();
+
+#ifndef _WIN32
+		if (options.timeout > 0.0)
+		{
+			qdata->finished = false;
+			qdata->client   = pc;
+			pthread_mutex_init(&qdata->timerlock, NULL);
+			pthread_cond_init(&qdata->timercond, NULL);
+
+			if (pthread_create(&qdata->timer, NULL, timeout_thread, (void*)qdata) != 0)
+			{
+				printf("Could not start timer thread\n");
+				exit(1);
+			}
+		}
+#endif
+
+		result = prestoclient_query(pc, options.sql, NULL, write_callback, describe_callback, (void*)qdata);
+		elapsed = get_time() - qdata->starttime;
+
+#ifndef _WIN32
+		if (options.timeout > 0.0)
+		{
+			pthread_mutex_lock(&qdata->timerlock);
+			qdata->finished = true;
+			pthread_cond_signal(&qdata->timercond);
+			pthread_mutex_unlock(&qdata->timerlock);
+
+			pthread_join(qdata->timer, NULL);
+			pthread_cond_destroy(&qdata->timercond);
+			pthread_mutex_destroy(&qdata->timerlock);
+		}
+#endif
+
+		/*
+		 * Write remaining output before printing any messages
+		 */
+		if (qdata->sink && !outputsink_close(qdata->sink) )
+		{
+			printf("Error writing output\n");
+			outputok = false;
+		}
+
+		qdata->sink = NULL;
+
+		if (qdata->progressshown)
+			fprintf(stderr, "\n");
+
+		if (qdata->timedout)
+			printf("Query cancelled after %.1f seconds\n", elapsed);
+
+		if (options.tracefile && !prestoclient_writetrace(options.tracefile) )
+			fprintf(stderr, "Could not write trace file '%s'\n", options.tracefile);
+
+		if (options.metrics)
+			print_metrics();
 
 		if (!result)
 		{
-			printf("Could not start query '%s' on server '%s'\n", argv[2], argv[1]);
+			printf("Could not start query '%s' on server '%s'\n", options.sql, options.server);
 		}
 		else
 		{
@@ -197,6 +776,9 @@ int main(int argc, char **argv)
 				 */
 				status = prestoclient_getstatus(result) == PRESTOCLIENT_STATUS_SUCCEEDED;
 
+				if (options.sinktype != SINK_TYPE_OUTPUT || options.stats)
+					print_benchmark(qdata, result);
+
 				/*
 				 * Messages from presto server
 				 */
@@ -230,11 +812,20 @@ int main(int argc, char **argv)
 	*/
 	prestoclient_close(pc);
 
-	if (qdata && qdata->cache)
-		free(qdata->cache);
+	if (qdata && qdata->sink)
+		outputsink_close(qdata->sink);
+
+	if (qdata && qdata->jsonprefix)
+	{
+		for (i = 0; i < qdata->jsoncolumncount; i++)
+			free(qdata->jsonprefix[i]);
+
+		free(qdata->jsonprefix);
+		free(qdata->jsonprefixlength);
+	}
 
 	if (qdata)
 		free(qdata);
 
-	return (status ? 0 : 1);
+	return (status && outputok ? 0 : 1);
 }
@@ -0,0 +1,444 @@
+/* This file is part of Easy to Oracle - Free Open Source Data Integration
+*
+* Copyright (C) 2014 Ivo Herweijer
+*
+* Easy to Oracle is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+* You can contact me via email: info@easydatawarehousing.com
+*/
+
+#ifndef _WIN32
+#define _GNU_SOURCE		/* O_DIRECT */
+#endif
+
+#include "outputsink.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif
+
+struct ST_OUTPUTSINK
+{
+	FILE				*stream;			/* Used for stdout and on platforms without the threaded writer */
+	char				*buffer[2];			/* Two blocks: one is filled while the other is written */
+	size_t				 blocksize;			/* Size of each block */
+	size_t				 used;				/* Bytes used in the active block */
+	int					 active;			/* Index of the block currently being filled */
+	bool				 error;				/* Set when a write failed */
+#ifndef _WIN32
+	int					 fd;				/* File descriptor or -1 when writing to stream */
+	bool				 directio;			/* File was opened with O_DIRECT */
+	bool				 dropcache;			/* Drop written pages from the page cache */
+	enum E_FSYNCPOLICY	 fsyncpolicy;		/* When to fsync */
+	off_t				 offset;			/* Number of bytes written to the file */
+	pthread_t			 thread;			/* Writer thread */
+	pthread_mutex_t		 lock;
+	pthread_cond_t		 cond;
+	bool				 pending;			/* A block has been handed to the writer thread */
+	int					 pendingindex;		/* Index of that block */
+	size_t				 pendingsize;		/* Number of bytes in that block */
+	bool				 stop;				/* Tells the writer thread to finish */
+#endif
+};
+
+static char* alloc_block(size_t size)
+{
+	void *block = NULL;
+
+#ifdef _WIN32
+	block = _aligned_malloc(size, OUTPUTSINK_ALIGNMENT);
+#else
+	if (posix_memalign(&block, OUTPUTSINK_ALIGNMENT, size) != 0)
+		block = NULL;
+#endif
+
+	if (!block)
+		exit(1);
+
+	return (char*)block;
+}
+
+static void free_block(char *block)
+{
+	if (!block)
+		return;
+
+#ifdef _WIN32
+	_aligned_free(block);
+#else
+	free(block);
+#endif
+}
+
+static OUTPUTSINK* new_outputsink(size_t blocksize, bool doublebuffer)
+{
+	OUTPUTSINK *sink = (OUTPUTSINK*)calloc(1, sizeof(OUTPUTSINK) );
+
+	if (!sink)
+		exit(1);
+
+	sink->blocksize = blocksize;
+	sink->buffer[0] = alloc_block(blocksize);
+	sink->buffer[1] = doublebuffer ? alloc_block(blocksize) : NULL;
+#ifndef _WIN32
+	sink->fd        = -1;
+#endif
+
+	return sink;
+}
+
+OUTPUTSINK* outputsink_open_stdout()
+{
+	OUTPUTSINK *sink = new_outputsink(OUTPUTSINK_STDOUT_BLOCKSIZE, false);
+
+	sink->stream = stdout;
+
+	return sink;
+}
+
+#ifndef _WIN32
+/*
+ * Write a complete buffer to the file, restarting after signals and short writes.
+ * With O_DIRECT only whole aligned blocks can be written, so for the final
+ * (partial) block O_DIRECT is switched off before writing the tail.
+ */
+static bool write_fully(OUTPUTSINK *sink, const char *data, size_t length)
+{
+	ssize_t	written;
+	size_t	aligned;
+	int		flags;
+
+	if (sink->directio && length % OUTPUTSINK_ALIGNMENT != 0)
+	{
+		aligned = length - length % OUTPUTSINK_ALIGNMENT;
+
+		if (aligned > 0 && !write_fully(sink, data, aligned) )
+			return false;
+
+#ifdef O_DIRECT
+		flags = fcntl(sink->fd, F_GETFL);
+		if (flags == -1 || fcntl(sink->fd, F_SETFL, flags & ~O_DIRECT) == -1)
+			return false;
+#else
+		(void)flags;
+#endif
+		sink->directio = false;
+
+		return write_fully(sink, data + aligned, length - aligned);
+	}
+
+	while (length > 0)
+	{
+		written = write(sink->fd, data, length);
+
+		if (written < 0)
+		{
+			if (errno == EINTR)
+				continue;
+
+			return false;
+		}
+
+		data         += written;
+		length       -= (size_t)written;
+		sink->offset += written;
+	}
+
+	return true;
+}
+
+/*
+ * Called by the writer thread for every block
+ */
+static void write_block(OUTPUTSINK *sink, const char *data, size_t length)
+{
+	off_t start = sink->offset;
+
+	if (!write_fully(sink, data, length) )
+	{
+		sink->error = true;
+		return;
+	}
+
+	if (sink->fsyncpolicy == OUTPUTSINK_FSYNC_BLOCK)
+	{
+		if (fdatasync(sink->fd) != 0)
+			sink->error = true;
+	}
+
+#ifdef POSIX_FADV_DONTNEED
+	/*
+	 * Pages that are still dirty can't be dropped, so when not syncing every block
+	 * advise on the previous block. Writeback for that one has usually finished by now.
+	 */
+	if (sink->dropcache)
+	{
+		if (sink->fsyncpolicy == OUTPUTSINK_FSYNC_BLOCK)
+			posix_fadvise(sink->fd, start, (off_t)length, POSIX_FADV_DONTNEED);
+		else if (start > 0)
+			posix_fadvise(sink->fd, start > (off_t)sink->blocksize ? start - (off_t)sink->blocksize : 0, (off_t)sink->blocksize, POSIX_FADV_DONTNEED);
+	}
+#else
+	(void)start;
+#endif
+}
+
+static void* writer_thread(void *in_sink)
+{
+	OUTPUTSINK	*sink = (OUTPUTSINK*)in_sink;
+	int			 index;
+	size_t		 size;
+
+	pthread_mutex_lock(&sink->lock);
+
+	for (;;)
+	{
+		while (!sink->pending && !sink->stop)
+			pthread_cond_wait(&sink->cond, &sink->lock);
+
+		if (!sink->pending)
+			break;
+
+		index = sink->pendingindex;
+		size  = sink->pendingsize;
+
+		/*
+		 * Write without holding the lock, the other block is being filled meanwhile
+		 */
+		pthread_mutex_unlock(&sink->lock);
+		write_block(sink, sink->buffer[index], size);
+		pthread_mutex_lock(&sink->lock);
+
+		sink->pending = false;
+		pthread_cond_broadcast(&sink->cond);
+	}
+
+	pthread_mutex_unlock(&sink->lock);
+
+	return NULL;
+}
+#endif
+
+OUTPUTSINK* outputsink_open_file(const char *filename, size_t blocksize, bool directio, bool dropcache, enum E_FSYNCPOLICY fsyncpolicy)
+{
+	OUTPUTSINK	*sink;
+
+	if (!filename)
+		return NULL;
+
+	/*
+	 * Round block size up to the alignment
+	 */
+	if (blocksize == 0)
+		blocksize = OUTPUTSINK_FILE_BLOCKSIZE;
+
+	blocksize = ( (blocksize + OUTPUTSINK_ALIGNMENT - 1) / OUTPUTSINK_ALIGNMENT) * OUTPUTSINK_ALIGNMENT;
+
+#ifdef _WIN32
+	/*
+	 * No background writer on Windows, write blocks synchronously
+	 */
+	(void)directio;
+	(void)dropcache;
+	(void)fsyncpolicy;
+
+	sink = new_outputsink(blocksize, false);
+	sink->stream = fopen(filename, "wb");
+
+	if (!sink->stream)
+	{
+		outputsink_close(sink);
+		return NULL;
+	}
+#else
+	{
+		int flags = O_WRONLY | O_CREAT | O_TRUNC;
+
+		sink = new_outputsink(blocksize, true);
+		sink->dropcache   = dropcache;
+		sink->fsyncpolicy = fsyncpolicy;
+
+#ifdef O_DIRECT
+		if (directio)
+		{
+			sink->fd = open(filename, flags | O_DIRECT, 0644);
+
+			/*
+			 * Not every filesystem supports O_DIRECT (tmpfs for example)
+			 */
+			if (sink->fd >= 0)
+				sink->directio = true;
+			else if (errno == EINVAL)
+				fprintf(stderr, "O_DIRECT not supported for '%s', using buffered writes\n", filename);
+		}
+#else
+		if (directio)
+			fprintf(stderr, "O_DIRECT not supported on this platform, using buffered writes\n");
+#endif
+
+		if (sink->fd < 0)
+			sink->fd = open(filename, flags, 0644);
+
+		if (sink->fd < 0)
+		{
+			free_block(sink->buffer[0]);
+			free_block(sink->buffer[1]);
+			free(sink);
+			return NULL;
+		}
+
+		pthread_mutex_init(&sink->lock, NULL);
+		pthread_cond_init(&sink->cond, NULL);
+
+		if (pthread_create(&sink->thread, NULL, writer_thread, (void*)sink) != 0)
+			exit(1);
+	}
+#endif
+
+	return sink;
+}
+
+/*
+ * Pass the active block on to be written and continue with the other block
+ */
+static void flush_block(OUTPUTSINK *sink)
+{
+	if (sink->used == 0)
+		return;
+
+#ifndef _WIN32
+	if (sink->fd >= 0)
+	{
+		pthread_mutex_lock(&sink->lock);
+
+		/*
+		 * Wait until the writer has finished the previous block
+		 */
+		while (sink->pending)
+			pthread_cond_wait(&sink->cond, &sink->lock);
+
+		sink->pendingindex = sink->active;
+		sink->pendingsize  = sink->used;
+		sink->pending      = true;
+		pthread_cond_broadcast(&sink->cond);
+
+		pthread_mutex_unlock(&sink->lock);
+
+		sink->active = 1 - sink->active;
+		sink->used   = 0;
+		return;
+	}
+#endif
+
+	if (fwrite(sink->buffer[0], 1, sink->used, sink->stream) != sink->used)
+		sink->error = true;
+
+	sink->used = 0;
+}
+
+void outputsink_write(OUTPUTSINK *sink, const char *data, size_t length)
+{
+	size_t chunk;
+
+	while (length > 0)
+	{
+		if (sink->used == sink->blocksize)
+			flush_block(sink);
+
+		chunk = sink->blocksize - sink->used;
+		if (chunk > length)
+			chunk = length;
+
+		memcpy(sink->buffer[sink->active] + sink->used, data, chunk);
+
+		sink->used += chunk;
+		data       += chunk;
+		length     -= chunk;
+	}
+}
+
+void outputsink_writestring(OUTPUTSINK *sink, const char *data)
+{
+	outputsink_write(sink, data, strlen(data) );
+}
+
+bool outputsink_close(OUTPUTSINK *sink)
+{
+	bool success;
+
+	if (!sink)
+		return false;
+
+	flush_block(sink);
+
+#ifndef _WIN32
+	if (sink->fd >= 0)
+	{
+		pthread_mutex_lock(&sink->lock);
+		sink->stop = true;
+		pthread_cond_broadcast(&sink->cond);
+		pthread_mutex_unlock(&sink->lock);
+
+		pthread_join(sink->thread, NULL);
+		pthread_cond_destroy(&sink->cond);
+		pthread_mutex_destroy(&sink->lock);
+
+		if (sink->fsyncpolicy != OUTPUTSINK_FSYNC_NONE && fsync(sink->fd) != 0)
+			sink->error = true;
+
+#ifdef POSIX_FADV_DONTNEED
+		if (sink->dropcache)
+		{
+			/*
+			 * Only clean pages are dropped, so flush the tail of the file first
+			 */
+			if (sink->fsyncpolicy == OUTPUTSINK_FSYNC_NONE)
+				fdatasync(sink->fd);
+
+			posix_fadvise(sink->fd, 0, 0, POSIX_FADV_DONTNEED);
+		}
+#endif
+
+		if (close(sink->fd) != 0)
+			sink->error = true;
+	}
+#endif
+
+	if (sink->stream)
+	{
+		if (sink->stream == stdout)
+		{
+			if (fflush(sink->stream) != 0)
+				sink->error = true;
+		}
+		else if (fclose(sink->stream) != 0)
+			sink->error = true;
+	}
+
+	success = !sink->error;
+
+	free_block(sink->buffer[0]);
+	free_block(sink->buffer[1]);
+	free(sink);
+
+	return success;
+}
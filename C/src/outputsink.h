@@ -0,0 +1,71 @@
+/* This file is part of Easy to Oracle - Free Open Source Data Integration
+*
+* Copyright (C) 2014 Ivo Herweijer
+*
+* Easy to Oracle is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+* You can contact me via email: info@easydatawarehousing.com
+*/
+
+#ifndef EASYPTORA_OUTPUTSINK_HH
+#define EASYPTORA_OUTPUTSINK_HH
+
+#include <stddef.h>
+
+#ifndef bool
+#define bool	signed char
+#define true	1
+#define false	0
+#endif
+
+#define OUTPUTSINK_STDOUT_BLOCKSIZE		(64 * 1024)		/* Buffer size used when writing to stdout */
+#define OUTPUTSINK_FILE_BLOCKSIZE		(1024 * 1024)	/* Default block size used when writing to a file */
+#define OUTPUTSINK_ALIGNMENT			4096			/* Alignment of file blocks, required for O_DIRECT */
+
+/*
+ * When to call fsync on an output file
+ */
+enum E_FSYNCPOLICY
+{
+	OUTPUTSINK_FSYNC_NONE = 0,		/* Leave it to the OS */
+	OUTPUTSINK_FSYNC_BLOCK,			/* After every block written */
+	OUTPUTSINK_FSYNC_END			/* Once, when closing the file */
+};
+
+/*
+ * Buffered output. Data is gathered in large blocks, file output uses two
+ * blocks so that a background thread writes one block while the next one is
+ * being filled.
+ */
+typedef struct ST_OUTPUTSINK OUTPUTSINK;
+
+OUTPUTSINK*	outputsink_open_stdout	();
+
+OUTPUTSINK*	outputsink_open_file	( const char *filename
+									, size_t blocksize
+									, bool directio
+									, bool dropcache
+									, enum E_FSYNCPOLICY fsyncpolicy);
+
+void		outputsink_write		(OUTPUTSINK *sink, const char *data, size_t length);
+
+void		outputsink_writestring	(OUTPUTSINK *sink, const char *data);
+
+/*
+ * Write all pending data, close the sink and free its memory.
+ * Returns false if any write failed.
+ */
+bool		outputsink_close		(OUTPUTSINK *sink);
+
+#endif /* EASYPTORA_OUTPUTSINK_HH */
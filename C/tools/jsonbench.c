@@ -0,0 +1,522 @@
+/*
+* This file is part of cPrestoClient
+*
+* Copyright (C) 2014 Ivo Herweijer
+*
+* cPrestoClient is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+* You can contact me via email: info@easydatawarehousing.com
+*/
+
+// jsonbench: micro-benchmark for the json stream parser.
+//
+// Response bodies are fed to the library exactly like curl does it: through WriteCallback, in chunks of
+// CURL_MAX_WRITE_SIZE bytes or in chunks of random size. No network is involved, so the numbers only
+// reflect parsing and handing values to the client. Bodies are either generated (see mockdata.h) for a
+// number of typical result shapes, or read from files containing recorded server responses.
+//
+// When built with JSONBENCH_COUNT_ALLOCS (GNU linker, see CMakeLists.txt) malloc, calloc and realloc
+// calls made by the library are counted and reported per row.
+
+#include "prestoclient.h"
+#include "prestoclienttypes.h"
+#include "mockdata.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+/* --- Defines -------------------------------------------------------------------------------------------------------- */
+#define JSONBENCH_MAX_FILES		256
+
+/* --- Enums ---------------------------------------------------------------------------------------------------------- */
+enum E_CHUNKMODES
+{
+	JSONBENCH_CHUNK_CURL = 0		// Every chunk is CURL_MAX_WRITE_SIZE bytes, like curl delivers a fast transfer
+,	JSONBENCH_CHUNK_RANDOM			// Random chunk sizes between 1 and CURL_MAX_WRITE_SIZE bytes
+};
+
+/* --- Structs -------------------------------------------------------------------------------------------------------- */
+typedef struct ST_BENCHSHAPE
+{
+	const char					 *name;							// Name used on the command line and in the report
+	const char					 *types;						// Column types, see mockdata_set_types
+	unsigned int				  columns;						// Number of columns
+	unsigned int				  varcharlength;				// Average length of varchar values
+	unsigned int				  nullpercent;					// Percentage of null values
+	bool						  escapes;						// Escape sequences and multibyte characters in varchars
+	unsigned long long			  rows;							// Default number of rows
+} BENCHSHAPE;
+
+typedef struct ST_CORPUS
+{
+	const char					 *name;							// Shape name or 'recorded'
+	MOCKBUFFER					 *pages;						// Response bodies
+	unsigned int				  pagecount;					// Number of response bodies
+	unsigned long long			  bytes;						// Total size of all bodies
+} CORPUS;
+
+typedef struct ST_BENCHCOUNTERS
+{
+	unsigned long long			  rows;							// Rows handed to the write callback
+	unsigned long long			  cells;						// Values visited
+	unsigned long long			  checksum;						// Sum of value lengths and nulls, must be equal for every run
+} BENCHCOUNTERS;
+
+typedef struct ST_BENCHOPTIONS
+{
+	const char					 *shape;						// Shape to run or NULL for all shapes
+	unsigned long long			  rows;							// Rows per shape, 0 uses the default of the shape
+	unsigned int				  pagerows;						// Rows per response body
+	unsigned int				  iterations;					// Number of runs, the fastest run is reported
+	bool						  chunkcurl;					// Run with CURL_MAX_WRITE_SIZE chunks
+	bool						  chunkrandom;					// Run with random chunk sizes
+	unsigned int				  seed;							// Seed for random chunk sizes
+	bool						  csv;							// Print the report as comma separated values
+	const char					 *files[JSONBENCH_MAX_FILES];	// Recorded response bodies
+	unsigned int				  filecount;					// Number of files
+} BENCHOPTIONS;
+
+/* --- Globals -------------------------------------------------------------------------------------------------------- */
+static const BENCHSHAPE shapes[] =
+{
+	{ "narrow",  "bigint,double,bigint,double",                    4,  0,  0, false, 500000 },
+	{ "wide",    "varchar",                                       48, 32,  0, false,  20000 },
+	{ "escaped", "varchar",                                        8, 32,  0, true,  100000 },
+	{ "nulls",   "bigint,varchar,double,boolean,date,timestamp",  16, 16, 80, false, 200000 }
+};
+
+static BENCHOPTIONS options;
+
+#ifdef JSONBENCH_COUNT_ALLOCS
+/* --- Allocation counting -------------------------------------------------------------------------------------------- */
+// The linker redirects malloc, calloc and realloc to these functions (-Wl,--wrap=malloc, etc)
+static unsigned long long allocations = 0;
+
+extern void* __real_malloc(size_t size);
+extern void* __real_calloc(size_t count, size_t size);
+extern void* __real_realloc(void *ptr, size_t size);
+
+void* __wrap_malloc(size_t size)
+{
+	allocations++;
+	return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size)
+{
+	allocations++;
+	return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void *ptr, size_t size)
+{
+	allocations++;
+	return __real_realloc(ptr, size);
+}
+#endif
+
+/* --- Functions ------------------------------------------------------------------------------------------------------ */
+static double get_time()
+{
+#ifdef _WIN32
+	LARGE_INTEGER frequency, counter;
+
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+
+	return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+#endif
+}
+
+// Small deterministic random generator, so every run uses the same chunk sizes
+static unsigned int next_random(unsigned long long *state)
+{
+	*state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+
+	return (unsigned int)(*state >> 33);
+}
+
+// Visit every value like a real client would
+static void write_callback(void *in_counters, void *in_result)
+{
+	BENCHCOUNTERS		*counters = (BENCHCOUNTERS*)in_counters;
+	PRESTOCLIENT_RESULT	*result   = (PRESTOCLIENT_RESULT*)in_result;
+	unsigned int		 i, columncount;
+
+	columncount = prestoclient_getcolumncount(result);
+
+	for (i = 0; i < columncount; i++)
+	{
+		if (prestoclient_getnullcolumnvalue(result, i) )
+			counters->checksum++;
+		else
+			counters->checksum += prestoclient_getcolumndatalength(result, i);
+	}
+
+	counters->cells += columncount;
+	counters->rows++;
+}
+
+static void build_corpus(CORPUS *corpus, const BENCHSHAPE *benchshape)
+{
+	MOCKSHAPE			shape;
+	MOCKPAGE			page;
+	char				nexturi[128];
+	unsigned long long	rows, firstrow;
+	unsigned int		i;
+
+	memset(&shape, 0, sizeof(MOCKSHAPE) );
+	shape.columns       = benchshape->columns;
+	shape.varcharlength = benchshape->varcharlength;
+	shape.nullpercent   = benchshape->nullpercent;
+	shape.escapes       = benchshape->escapes;
+	mockdata_set_types(&shape, benchshape->types);
+
+	rows = options.rows > 0 ? options.rows : benchshape->rows;
+
+	corpus->name      = benchshape->name;
+	corpus->pagecount = (unsigned int)( (rows + options.pagerows - 1) / options.pagerows);
+	corpus->pages     = (MOCKBUFFER*)calloc(corpus->pagecount > 0 ? corpus->pagecount : 1, sizeof(MOCKBUFFER) );
+	corpus->bytes     = 0;
+
+	if (!corpus->pages)
+		exit(1);
+
+	for (i = 0; i < corpus->pagecount; i++)
+	{
+		firstrow = (unsigned long long)i * options.pagerows;
+
+		memset(&page, 0, sizeof(MOCKPAGE) );
+		page.id              = "20141018_000000_00000_bench";
+		page.baseurl         = "http://localhost:8080";
+		page.withcolumns     = true;
+		page.firstrow        = firstrow;
+		page.rowcount        = (unsigned int)(rows - firstrow < options.pagerows ? rows - firstrow : options.pagerows);
+		page.totalrows       = rows;
+		page.totalsplits     = 16;
+		page.completedsplits = (unsigned int)(16ULL * (i + 1) / corpus->pagecount);
+
+		if (i + 1 < corpus->pagecount)
+		{
+			sprintf(nexturi, "http://localhost:8080/v1/statement/%s/%u", page.id, i + 2);
+			page.state   = "RUNNING";
+			page.nexturi = nexturi;
+		}
+		else
+			page.state   = "FINISHED";
+
+		mockdata_init_buffer(&corpus->pages[i]);
+		mockdata_response(&corpus->pages[i], &shape, &page);
+		corpus->bytes += corpus->pages[i].length;
+	}
+}
+
+static bool load_corpus(CORPUS *corpus)
+{
+	FILE			*file;
+	char			 block[65536];
+	size_t			 length;
+	unsigned int	 i;
+
+	corpus->name      = "recorded";
+	corpus->pagecount = options.filecount;
+	corpus->pages     = (MOCKBUFFER*)calloc(options.filecount, sizeof(MOCKBUFFER) );
+	corpus->bytes     = 0;
+
+	if (!corpus->pages)
+		exit(1);
+
+	for (i = 0; i < options.filecount; i++)
+	{
+		mockdata_init_buffer(&corpus->pages[i]);
+
+		file = fopen(options.files[i], "rb");
+		if (!file)
+		{
+			printf("Can't open '%s'\n", options.files[i]);
+			return false;
+		}
+
+		while ( (length = fread(block, 1, sizeof(block), file) ) > 0)
+			mockdata_append(&corpus->pages[i], block, length);
+
+		fclose(file);
+		corpus->bytes += corpus->pages[i].length;
+	}
+
+	return true;
+}
+
+static void free_corpus(CORPUS *corpus)
+{
+	unsigned int i;
+
+	for (i = 0; i < corpus->pagecount; i++)
+		mockdata_free_buffer(&corpus->pages[i]);
+
+	free(corpus->pages);
+}
+
+// Parse the complete corpus once. Returns false when the parser reported an error
+static bool run_corpus(const CORPUS *corpus, enum E_CHUNKMODES chunkmode, BENCHCOUNTERS *counters)
+{
+	PRESTOCLIENT_RESULT	*result;
+	unsigned long long	 random = options.seed;
+	unsigned int		 i;
+	size_t				 offset, chunk;
+	bool				 success = true;
+
+	memset(counters, 0, sizeof(BENCHCOUNTERS) );
+
+	// Same setup as prestoclient_query
+	result = new_prestoresult();
+	result->write_callback_function = write_callback;
+	result->client_object           = (void*)counters;
+	result->lastresponse            = (char*)malloc(CURL_MAX_WRITE_SIZE + 1);
+
+	if (!result->lastresponse)
+		exit(1);
+
+	result->lastresponse[0]        = 0;
+	result->lastresponsebuffersize = CURL_MAX_WRITE_SIZE;
+
+	for (i = 0; i < corpus->pagecount && success; i++)
+	{
+		for (offset = 0; offset < corpus->pages[i].length; offset += chunk)
+		{
+			if (chunkmode == JSONBENCH_CHUNK_RANDOM)
+				chunk = 1 + next_random(&random) % CURL_MAX_WRITE_SIZE;
+			else
+				chunk = CURL_MAX_WRITE_SIZE;
+
+			if (chunk > corpus->pages[i].length - offset)
+				chunk = corpus->pages[i].length - offset;
+
+			if (WriteCallback(corpus->pages[i].data + offset, 1, chunk, (void*)result) != chunk)
+			{
+				success = false;
+				break;
+			}
+		}
+
+		// Same as prestoclient_queryisrunning does after every request
+		json_reset_lexer(result->lexer);
+	}
+
+	delete_prestoresult(result);
+
+	return success;
+}
+
+static bool bench_corpus(const CORPUS *corpus, enum E_CHUNKMODES chunkmode, BENCHCOUNTERS *reference)
+{
+	BENCHCOUNTERS		counters;
+	double				start, elapsed, best = 0.0;
+	unsigned long long	allocs = 0;
+	unsigned int		i;
+	const char			*chunkname = chunkmode == JSONBENCH_CHUNK_RANDOM ? "random" : "curl";
+	double				mb = (double)corpus->bytes / (1024.0 * 1024.0);
+
+	for (i = 0; i < options.iterations; i++)
+	{
+#ifdef JSONBENCH_COUNT_ALLOCS
+		allocations = 0;
+#endif
+		start = get_time();
+
+		if (!run_corpus(corpus, chunkmode, &counters) )
+		{
+			printf("%s/%s: parse error\n", corpus->name, chunkname);
+			return false;
+		}
+
+		elapsed = get_time() - start;
+
+#ifdef JSONBENCH_COUNT_ALLOCS
+		allocs = allocations;
+#endif
+
+		if (i == 0 || elapsed < best)
+			best = elapsed;
+
+		// Every run must produce exactly the same values
+		if (reference->rows == 0 && reference->cells == 0)
+			*reference = counters;
+		else if (memcmp(reference, &counters, sizeof(BENCHCOUNTERS) ) != 0)
+		{
+			printf("%s/%s: result differs, %llu rows and checksum %llu instead of %llu rows and checksum %llu\n", corpus->name, chunkname,
+				   counters.rows, counters.checksum, reference->rows, reference->checksum);
+			return false;
+		}
+	}
+
+	if (best <= 0.0)
+		best = 1e-9;
+
+	if (options.csv)
+		printf("%s,%s,%llu,%llu,%llu,%.6f,%.2f,%.0f,%.0f,%.2f\n", corpus->name, chunkname, corpus->bytes, counters.rows, counters.cells, best,
+			   mb / best, (double)counters.rows / best, (double)counters.cells / best, counters.rows > 0 ? (double)allocs / (double)counters.rows : 0.0);
+	else
+		printf("%-10s %-7s %10.1f %10.1f %14.0f %14.0f %11.2f\n", corpus->name, chunkname, mb,
+			   mb / best, (double)counters.rows / best, (double)counters.cells / best, counters.rows > 0 ? (double)allocs / (double)counters.rows : 0.0);
+
+	fflush(stdout);
+
+	return true;
+}
+
+static bool bench(const CORPUS *corpus)
+{
+	BENCHCOUNTERS reference;
+
+	memset(&reference, 0, sizeof(BENCHCOUNTERS) );
+
+	if (options.chunkcurl && !bench_corpus(corpus, JSONBENCH_CHUNK_CURL, &reference) )
+		return false;
+
+	if (options.chunkrandom && !bench_corpus(corpus, JSONBENCH_CHUNK_RANDOM, &reference) )
+		return false;
+
+	return true;
+}
+
+static void print_usage()
+{
+	printf("Usage: jsonbench [options] [file ...]\n");
+	printf("Feeds presto responses through the json parser and reports throughput.\n");
+	printf("Files contain one recorded server response each, without files synthetic responses are used.\n");
+	printf("Options:\n");
+	printf("  --shape=<name>        Run one shape only: narrow, wide, escaped or nulls (default all)\n");
+	printf("  --rows=<n>            Number of rows per shape (default depends on the shape)\n");
+	printf("  --page-rows=<n>       Number of rows per response (default 1000)\n");
+	printf("  --iterations=<n>      Number of runs, the fastest run is reported (default 5)\n");
+	printf("  --chunks=curl|random|both  Chunk sizes passed to the parser (default both)\n");
+	printf("  --seed=<n>            Seed for the random chunk sizes (default 1)\n");
+	printf("  --csv                 Print results as comma separated values\n");
+}
+
+static bool parse_options(int argc, char **argv)
+{
+	int				i;
+	unsigned int	s;
+
+	memset(&options, 0, sizeof(BENCHOPTIONS) );
+	options.pagerows    = 1000;
+	options.iterations  = 5;
+	options.chunkcurl   = true;
+	options.chunkrandom = true;
+	options.seed        = 1;
+
+	for (i = 1; i < argc; i++)
+	{
+		if      (strncmp(argv[i], "--shape=",       8) == 0)	options.shape      = argv[i] + 8;
+		else if (strncmp(argv[i], "--rows=",        7) == 0)	options.rows       = strtoull(argv[i] + 7, NULL, 10);
+		else if (strncmp(argv[i], "--page-rows=",  12) == 0)	options.pagerows   = (unsigned int)strtoul(argv[i] + 12, NULL, 10);
+		else if (strncmp(argv[i], "--iterations=", 13) == 0)	options.iterations = (unsigned int)strtoul(argv[i] + 13, NULL, 10);
+		else if (strncmp(argv[i], "--seed=",        7) == 0)	options.seed       = (unsigned int)strtoul(argv[i] + 7, NULL, 10);
+		else if (strcmp (argv[i], "--csv")             == 0)	options.csv        = true;
+		else if (strncmp(argv[i], "--chunks=",      9) == 0)
+		{
+			options.chunkcurl   = strcmp(argv[i] + 9, "random") != 0;
+			options.chunkrandom = strcmp(argv[i] + 9, "curl")   != 0;
+
+			if (strcmp(argv[i] + 9, "curl") != 0 && strcmp(argv[i] + 9, "random") != 0 && strcmp(argv[i] + 9, "both") != 0)
+				return false;
+		}
+		else if (strncmp(argv[i], "--", 2) != 0 && options.filecount < JSONBENCH_MAX_FILES)
+			options.files[options.filecount++] = argv[i];
+		else
+		{
+			printf("Unknown option '%s'\n", argv[i]);
+			return false;
+		}
+	}
+
+	if (options.pagerows == 0 || options.iterations == 0)
+		return false;
+
+	if (options.shape)
+	{
+		for (s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++)
+		{
+			if (strcmp(options.shape, shapes[s].name) == 0)
+				break;
+		}
+
+		if (s == sizeof(shapes) / sizeof(shapes[0]) )
+		{
+			printf("Unknown shape '%s'\n", options.shape);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	CORPUS			corpus;
+	unsigned int	s;
+	bool			success = true;
+
+	if (!parse_options(argc, argv) )
+	{
+		print_usage();
+		exit(1);
+	}
+
+	if (options.csv)
+		printf("shape,chunks,bytes,rows,cells,seconds,mb_per_sec,rows_per_sec,cells_per_sec,allocs_per_row\n");
+	else
+		printf("%-10s %-7s %10s %10s %14s %14s %11s\n", "shape", "chunks", "MB", "MB/s", "rows/s", "cells/s", "allocs/row");
+
+	if (options.filecount > 0)
+	{
+		success = load_corpus(&corpus) && bench(&corpus);
+		free_corpus(&corpus);
+	}
+	else
+	{
+		// Continue with the next shape after a failure, but report it in the exit code
+		for (s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++)
+		{
+			if (options.shape && strcmp(options.shape, shapes[s].name) != 0)
+				continue;
+
+			build_corpus(&corpus, &shapes[s]);
+			if (!bench(&corpus) )
+				success = false;
+			free_corpus(&corpus);
+		}
+	}
+
+#ifndef JSONBENCH_COUNT_ALLOCS
+	if (!options.csv)
+		printf("Allocations are not counted in this build\n");
+#endif
+
+	return success ? 0 : 1;
+}
@@ -0,0 +1,572 @@
+/*
+* This file is part of cPrestoClient
+*
+* Copyright (C) 2014 Ivo Herweijer
+*
+* cPrestoClient is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+* You can contact me via email: info@easydatawarehousing.com
+*/
+
+// jsonsplit: differential test harness for the json stream parser.
+//
+// Curl hands a response to WriteCallback in blocks of arbitrary size, so any token, escape sequence or
+// UTF-8 character can be split over two blocks. This tool parses every response once as a whole (the
+// reference) and then again split at every possible byte boundary, one byte at a time and in random
+// blocks. Everything the parser emits (column info, rows, uri's, state, errors) is recorded in a
+// transcript and every transcript must equal the reference. For generated responses the reference is
+// also checked against the values the generator wrote.
+//
+// Build with PRESTOCLIENT_SANITIZERS=address,undefined to run under ASan/UBSan. When compiled with
+// JSONSPLIT_FUZZER this file provides a libFuzzer entry point instead of main, see CMakeLists.txt.
+
+#include "prestoclient.h"
+#include "prestoclienttypes.h"
+#include "mockdata.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+/* --- Defines -------------------------------------------------------------------------------------------------------- */
+#define JSONSPLIT_MAX_FILES		256
+#define JSONSPLIT_MAX_BLOCKS	(64 * 1024)
+
+/* --- Structs -------------------------------------------------------------------------------------------------------- */
+typedef struct ST_SPLITBODY
+{
+	char						  name[64];						// Name used in messages
+	MOCKBUFFER					  body;							// The response
+	const MOCKSHAPE				 *shape;						// Shape used to generate the response or NULL
+	const MOCKPAGE				 *page;							// Page used to generate the response or NULL
+} SPLITBODY;
+
+typedef struct ST_SPLITOPTIONS
+{
+	unsigned int				  randomruns;					// Number of random splits per response
+	unsigned int				  boundaries;					// Maximum number of two block splits per response
+	unsigned int				  seed;							// Seed for the random splits
+	bool						  verbose;						// Print every response tested
+	const char					 *files[JSONSPLIT_MAX_FILES];	// Recorded response bodies
+	unsigned int				  filecount;					// Number of files
+} SPLITOPTIONS;
+
+/* --- Globals -------------------------------------------------------------------------------------------------------- */
+static size_t blocks[JSONSPLIT_MAX_BLOCKS];
+
+/* --- Transcript ----------------------------------------------------------------------------------------------------- */
+static void transcript_string(MOCKBUFFER *transcript, const char *label, const char *value)
+{
+	char text[32];
+
+	sprintf(text, "%s %u:", label, value ? (unsigned int)strlen(value) : 0);
+	mockdata_appendstring(transcript, text);
+
+	if (value)
+		mockdata_appendstring(transcript, value);
+
+	mockdata_append(transcript, "\n", 1);
+}
+
+static void describe_callback(void *in_transcript, void *in_result)
+{
+	MOCKBUFFER			*transcript = (MOCKBUFFER*)in_transcript;
+	PRESTOCLIENT_RESULT	*result     = (PRESTOCLIENT_RESULT*)in_result;
+	unsigned int		 i, columncount;
+	char				 text[32];
+
+	columncount = prestoclient_getcolumncount(result);
+
+	for (i = 0; i < columncount; i++)
+	{
+		sprintf(text, "column %u", prestoclient_getcolumntype(result, i) );
+		transcript_string(transcript, text, prestoclient_getcolumnname(result, i) );
+	}
+}
+
+static void write_callback(void *in_transcript, void *in_result)
+{
+	MOCKBUFFER			*transcript = (MOCKBUFFER*)in_transcript;
+	PRESTOCLIENT_RESULT	*result     = (PRESTOCLIENT_RESULT*)in_result;
+	unsigned int		 i, columncount, length;
+	char				 text[32];
+
+	columncount = prestoclient_getcolumncount(result);
+
+	for (i = 0; i < columncount; i++)
+	{
+		if (prestoclient_getnullcolumnvalue(result, i) )
+		{
+			mockdata_append(transcript, "N", 1);
+			continue;
+		}
+
+		// Length must match the string, a stray terminator would show up here
+		length = prestoclient_getcolumndatalength(result, i);
+		sprintf(text, "%c%u:", prestoclient_getcolumndataisstring(result, i) ? 'S' : 'V', length);
+		mockdata_appendstring(transcript, text);
+		mockdata_append(transcript, prestoclient_getcolumndata(result, i), length);
+	}
+
+	mockdata_append(transcript, "\n", 1);
+}
+
+// Parse a response delivered in the given blocks and record everything the parser produced
+static void parse(const MOCKBUFFER *body, const size_t *blocksizes, unsigned int blockcount, MOCKBUFFER *transcript)
+{
+	PRESTOCLIENT_RESULT	*result;
+	unsigned int		 i;
+	size_t				 offset = 0;
+	bool				 accepted = true;
+
+	transcript->length  = 0;
+	transcript->data[0] = 0;
+
+	// Same setup as prestoclient_query
+	result = new_prestoresult();
+	result->write_callback_function    = write_callback;
+	result->describe_callback_function = describe_callback;
+	result->client_object              = (void*)transcript;
+	result->lastresponse               = (char*)malloc(CURL_MAX_WRITE_SIZE + 1);
+
+	if (!result->lastresponse)
+		exit(1);
+
+	result->lastresponse[0]        = 0;
+	result->lastresponsebuffersize = CURL_MAX_WRITE_SIZE;
+
+	for (i = 0; i < blockcount && accepted; i++)
+	{
+		// Curl stops the transfer as soon as the callback doesn't accept a block
+		accepted = WriteCallback(body->data + offset, 1, blocksizes[i], (void*)result) == blocksizes[i];
+		offset += blocksizes[i];
+	}
+
+	transcript_string(transcript, "accepted", accepted ? "yes" : "no");
+	transcript_string(transcript, "infouri",  result->lastinfouri);
+	transcript_string(transcript, "nexturi",  result->lastnexturi);
+	transcript_string(transcript, "canceluri", result->lastcanceluri);
+	transcript_string(transcript, "state",    result->laststate);
+	transcript_string(transcript, "error",    result->lasterrormessage);
+
+	delete_prestoresult(result);
+}
+
+// Report where two transcripts differ
+static bool compare(const SPLITBODY *test, const MOCKBUFFER *reference, const MOCKBUFFER *transcript, const char *how)
+{
+	size_t i, start;
+
+	if (reference->length == transcript->length && memcmp(reference->data, transcript->data, reference->length) == 0)
+		return true;
+
+	for (i = 0; i < reference->length && i < transcript->length && reference->data[i] == transcript->data[i]; i++)
+		;
+
+	start = i > 40 ? i - 40 : 0;
+
+	printf("%s: %s differs from the reference at offset %u\n", test->name, how, (unsigned int)i);
+	printf("  expected: %.80s\n", reference->data + start);
+	printf("  found:    %.80s\n", transcript->data + (start < transcript->length ? start : transcript->length) );
+
+	return false;
+}
+
+/* --- Reference check ------------------------------------------------------------------------------------------------ */
+// Check the reference transcript against the values the generator wrote
+static bool verify_reference(const SPLITBODY *test, const MOCKBUFFER *reference)
+{
+	MOCKBUFFER		expected, value;
+	unsigned int	r, c;
+	char			text[32];
+
+	mockdata_init_buffer(&expected);
+	mockdata_init_buffer(&value);
+
+	for (c = 0; c < test->shape->columns && test->page->withcolumns; c++)
+	{
+		switch (test->shape->types[c])
+		{
+			case MOCK_TYPE_BIGINT:
+			case MOCK_TYPE_INTEGER:		sprintf(text, "column %u", PRESTOCLIENT_TYPE_BIGINT);		break;
+			case MOCK_TYPE_DOUBLE:
+			case MOCK_TYPE_REAL:		sprintf(text, "column %u", PRESTOCLIENT_TYPE_DOUBLE);		break;
+			case MOCK_TYPE_BOOLEAN:		sprintf(text, "column %u", PRESTOCLIENT_TYPE_BOOLEAN);		break;
+			case MOCK_TYPE_DATE:		sprintf(text, "column %u", PRESTOCLIENT_TYPE_DATE);			break;
+			case MOCK_TYPE_TIMESTAMP:	sprintf(text, "column %u", PRESTOCLIENT_TYPE_TIMESTAMP);	break;
+			default:					sprintf(text, "column %u", PRESTOCLIENT_TYPE_VARCHAR);		break;
+		}
+
+		sprintf(text + strlen(text), " %u:c%u\n", c < 10 ? 2 : (c < 100 ? 3 : 4), c);
+		mockdata_appendstring(&expected, text);
+	}
+
+	for (r = 0; r < test->page->rowcount; r++)
+	{
+		for (c = 0; c < test->shape->columns; c++)
+		{
+			value.length  = 0;
+			value.data[0] = 0;
+			mockdata_value(&value, test->shape, test->page->firstrow + r, c);
+
+			// Strings lose their quotes, booleans become 1 or 0
+			if (strcmp(value.data, "null") == 0)
+				mockdata_append(&expected, "N", 1);
+			else if (value.data[0] == '\"')
+			{
+				sprintf(text, "S%u:", (unsigned int)value.length - 2);
+				mockdata_appendstring(&expected, text);
+				mockdata_append(&expected, value.data + 1, value.length - 2);
+			}
+			else if (strcmp(value.data, "true") == 0 || strcmp(value.data, "false") == 0)
+				mockdata_appendstring(&expected, value.data[0] == 't' ? "V1:1" : "V1:0");
+			else
+			{
+				sprintf(text, "V%u:", (unsigned int)value.length);
+				mockdata_appendstring(&expected, text);
+				mockdata_append(&expected, value.data, value.length);
+			}
+		}
+
+		mockdata_append(&expected, "\n", 1);
+	}
+
+	// Only rows and columns are generated, uri's and state follow in the reference
+	if (reference->length < expected.length || memcmp(reference->data, expected.data, expected.length) != 0 ||
+		strncmp(reference->data + expected.length, "accepted 3:yes\n", 15) != 0)
+	{
+		expected.length = reference->length < expected.length ? reference->length : expected.length;
+		compare(test, &expected, reference, "reference parse");
+		mockdata_free_buffer(&expected);
+		mockdata_free_buffer(&value);
+		return false;
+	}
+
+	mockdata_free_buffer(&expected);
+	mockdata_free_buffer(&value);
+
+	return true;
+}
+
+/* --- Tests ---------------------------------------------------------------------------------------------------------- */
+// Small deterministic random generator, so failures can be reproduced with the same seed
+static unsigned int next_random(unsigned long long *state)
+{
+	*state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+
+	return (unsigned int)(*state >> 33);
+}
+
+// Fill blocks with random sizes. Mostly small blocks so splits land inside tokens, sometimes large ones
+static unsigned int random_blocks(unsigned long long *random, size_t length)
+{
+	unsigned int	count = 0;
+	size_t			size;
+
+	while (length > 0 && count < JSONSPLIT_MAX_BLOCKS - 1)
+	{
+		if (next_random(random) % 8 == 0)
+			size = 1 + next_random(random) % CURL_MAX_WRITE_SIZE;
+		else
+			size = 1 + next_random(random) % 7;
+
+		if (size > length)
+			size = length;
+
+		blocks[count++] = size;
+		length -= size;
+	}
+
+	if (length > 0)
+		blocks[count++] = length;
+
+	return count;
+}
+
+static bool split_test(const SPLITBODY *test, const SPLITOPTIONS *options, unsigned long long *parses)
+{
+	MOCKBUFFER			reference, transcript;
+	size_t				length = test->body.length;
+	size_t				i, step;
+	unsigned int		r, count;
+	unsigned long long	random = options->seed;
+	char				how[64];
+	bool				success = true;
+
+	mockdata_init_buffer(&reference);
+	mockdata_init_buffer(&transcript);
+
+	// Reference: the complete response in one block
+	blocks[0] = length;
+	parse(&test->body, blocks, 1, &reference);
+	(*parses)++;
+
+	if (test->shape && !verify_reference(test, &reference) )
+		success = false;
+
+	// Two blocks, split at every byte. Large responses are split at every step'th byte
+	step = options->boundaries > 0 && length > options->boundaries ? length / options->boundaries + 1 : 1;
+
+	for (i = 1; i < length && success; i += step)
+	{
+		blocks[0] = i;
+		blocks[1] = length - i;
+		parse(&test->body, blocks, 2, &transcript);
+		(*parses)++;
+
+		sprintf(how, "split at byte %u", (unsigned int)i);
+		success = compare(test, &reference, &transcript, how);
+	}
+
+	// One byte at a time
+	if (success && length < JSONSPLIT_MAX_BLOCKS)
+	{
+		for (i = 0; i < length; i++)
+			blocks[i] = 1;
+
+		parse(&test->body, blocks, (unsigned int)length, &transcript);
+		(*parses)++;
+
+		success = compare(test, &reference, &transcript, "one byte blocks");
+	}
+
+	// Random blocks
+	for (r = 0; r < options->randomruns && success; r++)
+	{
+		count = random_blocks(&random, length);
+		parse(&test->body, blocks, count, &transcript);
+		(*parses)++;
+
+		sprintf(how, "random split %u (seed %u)", r, options->seed);
+		success = compare(test, &reference, &transcript, how);
+	}
+
+	mockdata_free_buffer(&reference);
+	mockdata_free_buffer(&transcript);
+
+	return success;
+}
+
+#ifdef JSONSPLIT_FUZZER
+/* --- libFuzzer entry point ------------------------------------------------------------------------------------------ */
+// The first 8 bytes seed the random splits, the rest is the response
+int LLVMFuzzerTestOneInput(const unsigned char *data, size_t size)
+{
+	static MOCKBUFFER	reference, transcript;
+	static bool			initialized = false;
+	SPLITBODY			test;
+	unsigned long long	random = 0;
+	unsigned int		count;
+
+	if (size < 8 || size - 8 > JSONSPLIT_MAX_BLOCKS)
+		return 0;
+
+	if (!initialized)
+	{
+		mockdata_init_buffer(&reference);
+		mockdata_init_buffer(&transcript);
+		initialized = true;
+	}
+
+	memcpy(&random, data, 8);
+
+	memset(&test, 0, sizeof(SPLITBODY) );
+	strcpy(test.name, "fuzz");
+	test.body.data   = (char*)data + 8;
+	test.body.length = size - 8;
+
+	blocks[0] = test.body.length;
+	parse(&test.body, blocks, test.body.length > 0 ? 1 : 0, &reference);
+
+	count = random_blocks(&random, test.body.length);
+	parse(&test.body, blocks, count, &transcript);
+
+	if (!compare(&test, &reference, &transcript, "random split") )
+		abort();
+
+	return 0;
+}
+#else
+/* --- Main ----------------------------------------------------------------------------------------------------------- */
+// Generated responses: every shape once with escapes, nulls and all types, plus the non-data pages
+static unsigned int build_tests(SPLITBODY *tests, MOCKSHAPE *shapes, MOCKPAGE *pages)
+{
+	unsigned int	i, count = 0;
+	static const char *shapetypes[] = { "varchar", "bigint,double,boolean,varchar,date,timestamp", "varchar,double", "bigint",
+										"integer,real,array,map,array,bigint" };
+
+	for (i = 0; i < 5; i++)
+	{
+		memset(&shapes[i], 0, sizeof(MOCKSHAPE) );
+		shapes[i].columns       = i == 3 ? 1 : 6;
+		shapes[i].varcharlength = i == 0 ? 24 : 8;
+		shapes[i].nullpercent   = i == 1 ? 40 : (i == 3 ? 50 : (i == 4 ? 20 : 0) );
+		shapes[i].escapes       = i != 3;
+		mockdata_set_types(&shapes[i], shapetypes[i]);
+
+		memset(&pages[i], 0, sizeof(MOCKPAGE) );
+		pages[i].id              = "20141018_000000_00000_split";
+		pages[i].baseurl         = "http://localhost:8080";
+		pages[i].nexturi         = i < 2 || i == 4 ? "http://localhost:8080/v1/statement/20141018_000000_00000_split/3" : NULL;
+		pages[i].state           = i < 2 || i == 4 ? "RUNNING" : "FINISHED";
+		pages[i].withcolumns     = true;
+		pages[i].firstrow        = 1000 * i;
+		pages[i].rowcount        = i == 3 ? 40 : 12;
+		pages[i].totalrows       = 100;
+		pages[i].totalsplits     = 16;
+		pages[i].completedsplits = 4 * i;
+
+		strcpy(tests[count].name, "data page ");
+		strcat(tests[count].name, shapetypes[i]);
+		tests[count].shape = &shapes[i];
+		tests[count].page  = &pages[i];
+		count++;
+	}
+
+	// Queued: no columns and no data
+	pages[5]             = pages[0];
+	pages[5].state       = "QUEUED";
+	pages[5].withcolumns = false;
+	pages[5].rowcount    = 0;
+	strcpy(tests[count].name, "queued page");
+	tests[count].shape = &shapes[0];
+	tests[count].page  = &pages[5];
+	count++;
+
+	// Failed query with an error section
+	pages[6]              = pages[5];
+	pages[6].state        = "FAILED";
+	pages[6].nexturi      = NULL;
+	pages[6].errormessage = "line 1:8: mismatched input 'fail'";
+	strcpy(tests[count].name, "error page");
+	tests[count].shape = &shapes[0];
+	tests[count].page  = &pages[6];
+	count++;
+
+	for (i = 0; i < count; i++)
+	{
+		mockdata_init_buffer(&tests[i].body);
+		mockdata_response(&tests[i].body, tests[i].shape, tests[i].page);
+	}
+
+	return count;
+}
+
+static bool load_file(SPLITBODY *test, const char *filename)
+{
+	FILE	*file;
+	char	 block[65536];
+	size_t	 length;
+
+	memset(test, 0, sizeof(SPLITBODY) );
+	strncpy(test->name, filename, sizeof(test->name) - 1);
+	mockdata_init_buffer(&test->body);
+
+	file = fopen(filename, "rb");
+	if (!file)
+	{
+		printf("Can't open '%s'\n", filename);
+		return false;
+	}
+
+	while ( (length = fread(block, 1, sizeof(block), file) ) > 0)
+		mockdata_append(&test->body, block, length);
+
+	fclose(file);
+
+	return true;
+}
+
+static void print_usage()
+{
+	printf("Usage: jsonsplit [options] [file ...]\n");
+	printf("Parses responses split at every byte and in random blocks and compares the results.\n");
+	printf("Files contain one recorded server response each, without files generated responses are used.\n");
+	printf("Options:\n");
+	printf("  --random=<n>          Number of random splits per response (default 200)\n");
+	printf("  --boundaries=<n>      Larger responses are split at n evenly spaced positions only (default 20000, 0 = all)\n");
+	printf("  --seed=<n>            Seed for the random splits (default 1)\n");
+	printf("  --verbose             Print every response tested\n");
+}
+
+static bool parse_options(int argc, char **argv, SPLITOPTIONS *options)
+{
+	int i;
+
+	memset(options, 0, sizeof(SPLITOPTIONS) );
+	options->randomruns = 200;
+	options->boundaries = 20000;
+	options->seed       = 1;
+
+	for (i = 1; i < argc; i++)
+	{
+		if      (strncmp(argv[i], "--random=",      9) == 0)	options->randomruns = (unsigned int)strtoul(argv[i] +  9, NULL, 10);
+		else if (strncmp(argv[i], "--boundaries=", 13) == 0)	options->boundaries = (unsigned int)strtoul(argv[i] + 13, NULL, 10);
+		else if (strncmp(argv[i], "--seed=",        7) == 0)	options->seed       = (unsigned int)strtoul(argv[i] +  7, NULL, 10);
+		else if (strcmp (argv[i], "--verbose")         == 0)	options->verbose    = true;
+		else if (strncmp(argv[i], "--", 2) != 0 && options->filecount < JSONSPLIT_MAX_FILES)
+			options->files[options->filecount++] = argv[i];
+		else
+		{
+			printf("Unknown option '%s'\n", argv[i]);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	SPLITOPTIONS		options;
+	SPLITBODY			tests[JSONSPLIT_MAX_FILES];
+	MOCKSHAPE			shapes[5];
+	MOCKPAGE			pages[7];
+	unsigned int		i, count = 0, failures = 0;
+	unsigned long long	parses = 0;
+
+	if (!parse_options(argc, argv, &options) )
+	{
+		print_usage();
+		exit(1);
+	}
+
+	if (options.filecount > 0)
+	{
+		for (i = 0; i < options.filecount; i++)
+		{
+			if (!load_file(&tests[count], options.files[i]) )
+				exit(1);
+
+			count++;
+		}
+	}
+	else
+		count = build_tests(tests, shapes, pages);
+
+	for (i = 0; i < count; i++)
+	{
+		if (options.verbose)
+			printf("%s: %u bytes\n", tests[i].name, (unsigned int)tests[i].body.length);
+
+		if (!split_test(&tests[i], &options, &parses) )
+			failures++;
+
+		mockdata_free_buffer(&tests[i].body);
+	}
+
+	printf("%u responses, %llu parses, %u failed\n", count, parses, failures);
+
+	return failures > 0 ? 1 : 0;
+}
+#endif
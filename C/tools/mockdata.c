@@ -0,0 +1,404 @@
+/*
+* This file is part of cPrestoClient
+*
+* Copyright (C) 2014 Ivo Herweijer
+*
+* cPrestoClient is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+* You can contact me via email: info@easydatawarehousing.com
+*/
+
+#include "mockdata.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+// Pieces used to build varchar values with escapes. Includes 2, 3 and 4 byte UTF-8 characters.
+static const char *escapepieces[] =
+{
+	"\\\"", "\\\\", "\\n", "\\t", "\\u00e9", "\\/", "\xc3\xa9", "\xe2\x82\xac", "\xf0\x9f\x98\x80"
+};
+
+static const char alphabet[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 ";
+
+// Deterministic pseudo random value for a cell (splitmix64)
+static unsigned long long mockdata_hash(unsigned long long row, unsigned int column, unsigned int salt)
+{
+	unsigned long long z = row * 0x9E3779B97F4A7C15ULL + ( (unsigned long long)column << 32) + salt;
+
+	z = (z ^ (z >> 30) ) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27) ) * 0x94D049BB133111EBULL;
+
+	return z ^ (z >> 31);
+}
+
+void mockdata_init_buffer(MOCKBUFFER *buffer)
+{
+	buffer->size   = 64 * 1024;
+	buffer->length = 0;
+	buffer->data   = (char*)malloc(buffer->size);
+
+	if (!buffer->data)
+		exit(1);
+
+	buffer->data[0] = 0;
+}
+
+void mockdata_free_buffer(MOCKBUFFER *buffer)
+{
+	if (buffer->data)
+		free(buffer->data);
+
+	buffer->data   = NULL;
+	buffer->size   = 0;
+	buffer->length = 0;
+}
+
+void mockdata_append(MOCKBUFFER *buffer, const char *text, size_t length)
+{
+	if (buffer->length + length + 1 > buffer->size)
+	{
+		while (buffer->length + length + 1 > buffer->size)
+			buffer->size *= 2;
+
+		buffer->data = (char*)realloc(buffer->data, buffer->size);
+
+		if (!buffer->data)
+			exit(1);
+	}
+
+	memcpy(buffer->data + buffer->length, text, length);
+	buffer->length += length;
+	buffer->data[buffer->length] = 0;
+}
+
+void mockdata_appendstring(MOCKBUFFER *buffer, const char *text)
+{
+	mockdata_append(buffer, text, strlen(text) );
+}
+
+const char* mockdata_typename(enum E_MOCKTYPES type)
+{
+	switch (type)
+	{
+		case MOCK_TYPE_BIGINT:		return "bigint";
+		case MOCK_TYPE_DOUBLE:		return "double";
+		case MOCK_TYPE_BOOLEAN:		return "boolean";
+		case MOCK_TYPE_VARCHAR:		return "varchar";
+		case MOCK_TYPE_DATE:		return "date";
+		case MOCK_TYPE_TIMESTAMP:	return "timestamp";
+		case MOCK_TYPE_INTEGER:		return "integer";
+		case MOCK_TYPE_REAL:		return "real";
+		case MOCK_TYPE_ARRAY:		return "array(bigint)";
+		case MOCK_TYPE_MAP:			return "map(varchar,array(varchar))";
+	}
+
+	return "varchar";
+}
+
+bool mockdata_set_types(MOCKSHAPE *shape, const char *typelist)
+{
+	enum E_MOCKTYPES	types[MOCKDATA_MAX_COLUMNS];
+	unsigned int		i, typecount = 0;
+	const char			*start = typelist, *end;
+	size_t				length;
+
+	while (start && *start && typecount < MOCKDATA_MAX_COLUMNS)
+	{
+		end    = strchr(start, ',');
+		length = end ? (size_t)(end - start) : strlen(start);
+
+		if      (length == 6 && strncmp(start, "bigint",    6) == 0)	types[typecount++] = MOCK_TYPE_BIGINT;
+		else if (length == 6 && strncmp(start, "double",    6) == 0)	types[typecount++] = MOCK_TYPE_DOUBLE;
+		else if (length == 7 && strncmp(start, "boolean",   7) == 0)	types[typecount++] = MOCK_TYPE_BOOLEAN;
+		else if (length == 7 && strncmp(start, "varchar",   7) == 0)	types[typecount++] = MOCK_TYPE_VARCHAR;
+		else if (length == 4 && strncmp(start, "date",      4) == 0)	types[typecount++] = MOCK_TYPE_DATE;
+		else if (length == 9 && strncmp(start, "timestamp", 9) == 0)	types[typecount++] = MOCK_TYPE_TIMESTAMP;
+		else if (length == 7 && strncmp(start, "integer",   7) == 0)	types[typecount++] = MOCK_TYPE_INTEGER;
+		else if (length == 4 && strncmp(start, "real",      4) == 0)	types[typecount++] = MOCK_TYPE_REAL;
+		else if (length == 5 && strncmp(start, "array",     5) == 0)	types[typecount++] = MOCK_TYPE_ARRAY;
+		else if (length == 3 && strncmp(start, "map",       3) == 0)	types[typecount++] = MOCK_TYPE_MAP;
+		else
+			return false;
+
+		start = end ? end + 1 : NULL;
+	}
+
+	if (typecount == 0)
+		return false;
+
+	for (i = 0; i < shape->columns && i < MOCKDATA_MAX_COLUMNS; i++)
+		shape->types[i] = types[i % typecount];
+
+	return true;
+}
+
+static void mockdata_varchar(MOCKBUFFER *buffer, const MOCKSHAPE *shape, unsigned long long hash)
+{
+	char			text[8];
+	unsigned int	i, length;
+	const char		*piece;
+
+	length = shape->varcharlength > 0 ? shape->varcharlength / 2 + (unsigned int)(hash % (shape->varcharlength + 1) ) : 0;
+
+	mockdata_append(buffer, "\"", 1);
+
+	for (i = 0; i < length; i++)
+	{
+		hash = hash * 6364136223846793005ULL + 1442695040888963407ULL;
+
+		if (shape->escapes && (hash >> 60) < 5)
+		{
+			piece = escapepieces[(hash >> 33) % (sizeof(escapepieces) / sizeof(escapepieces[0]) )];
+			mockdata_appendstring(buffer, piece);
+		}
+		else
+		{
+			text[0] = alphabet[(hash >> 33) % (sizeof(alphabet) - 1)];
+			mockdata_append(buffer, text, 1);
+		}
+	}
+
+	mockdata_append(buffer, "\"", 1);
+}
+
+// Nested values are written as compact json, the way the server sends them. Up to 3 elements, some of them null
+static void mockdata_nested(MOCKBUFFER *buffer, const MOCKSHAPE *shape, enum E_MOCKTYPES type, unsigned long long hash)
+{
+	char			text[32];
+	unsigned int	i, count = (unsigned int)(hash % 4);
+
+	mockdata_append(buffer, type == MOCK_TYPE_MAP ? "{" : "[", 1);
+
+	for (i = 0; i < count; i++)
+	{
+		hash = hash * 6364136223846793005ULL + 1442695040888963407ULL;
+
+		if (i > 0)
+			mockdata_append(buffer, ",", 1);
+
+		if (type == MOCK_TYPE_MAP)
+		{
+			// Keys must be unique
+			sprintf(text, "\"k%u\":", i);
+			mockdata_appendstring(buffer, text);
+
+			if ( (hash >> 40) % 5 == 0)
+				mockdata_append(buffer, "null", 4);
+			else
+			{
+				mockdata_append(buffer, "[", 1);
+				mockdata_varchar(buffer, shape, hash >> 8);
+				mockdata_append(buffer, "]", 1);
+			}
+		}
+		else if ( (hash >> 40) % 5 == 0)
+			mockdata_append(buffer, "null", 4);
+		else
+		{
+			sprintf(text, "%lld", (long long)( (hash >> 8) % 2001ULL) - 1000LL);
+			mockdata_appendstring(buffer, text);
+		}
+	}
+
+	mockdata_append(buffer, type == MOCK_TYPE_MAP ? "}" : "]", 1);
+}
+
+void mockdata_value(MOCKBUFFER *buffer, const MOCKSHAPE *shape, unsigned long long row, unsigned int column)
+{
+	char				text[64];
+	unsigned long long	hash = mockdata_hash(row, column, 0);
+
+	if (shape->nullpercent > 0 && mockdata_hash(row, column, 1) % 100 < shape->nullpercent)
+	{
+		mockdata_append(buffer, "null", 4);
+		return;
+	}
+
+	switch (shape->types[column])
+	{
+		case MOCK_TYPE_BIGINT:
+		{
+			sprintf(text, "%lld", (long long)(hash % 2000000001ULL) - 1000000000LL);
+			break;
+		}
+
+		case MOCK_TYPE_DOUBLE:
+		{
+			// The server sends special values as strings
+			if (shape->escapes && hash % 50 == 0)
+				strcpy(text, "\"NaN\"");
+			else
+				sprintf(text, "%.10g", (double)( (long long)(hash % 2000000001ULL) - 1000000000LL) / 7.0);
+			break;
+		}
+
+		case MOCK_TYPE_INTEGER:
+		{
+			sprintf(text, "%lld", (long long)(hash % 200001ULL) - 100000LL);
+			break;
+		}
+
+		case MOCK_TYPE_REAL:
+		{
+			// Exactly representable in a float, so every client reads the same value
+			sprintf(text, "%.10g", (double)( (long long)(hash % 20001ULL) - 10000LL) / 4.0);
+			break;
+		}
+
+		case MOCK_TYPE_ARRAY:
+		case MOCK_TYPE_MAP:
+		{
+			mockdata_nested(buffer, shape, shape->types[column], hash);
+			return;
+		}
+
+		case MOCK_TYPE_BOOLEAN:
+		{
+			strcpy(text, (hash & 1) ? "true" : "false");
+			break;
+		}
+
+		case MOCK_TYPE_DATE:
+		{
+			sprintf(text, "\"2014-%02u-%02u\"", (unsigned int)(hash % 12) + 1, (unsigned int)( (hash >> 8) % 28) + 1);
+			break;
+		}
+
+		case MOCK_TYPE_TIMESTAMP:
+		{
+			sprintf(text, "\"2014-%02u-%02u %02u:%02u:%02u.%03u\"", (unsigned int)(hash % 12) + 1, (unsigned int)( (hash >> 8) % 28) + 1,
+					(unsigned int)( (hash >> 16) % 24), (unsigned int)( (hash >> 24) % 60), (unsigned int)( (hash >> 32) % 60), (unsigned int)( (hash >> 40) % 1000) );
+			break;
+		}
+
+		case MOCK_TYPE_VARCHAR:
+		default:
+		{
+			mockdata_varchar(buffer, shape, hash);
+			return;
+		}
+	}
+
+	mockdata_appendstring(buffer, text);
+}
+
+static void mockdata_stats(MOCKBUFFER *buffer, const MOCKPAGE *page, const char *name, bool withsubstages)
+{
+	char				text[512];
+	unsigned int		total     = page->totalsplits;
+	unsigned int		completed = page->completedsplits > total ? total : page->completedsplits;
+	unsigned int		running   = total - completed > 4 ? 4 : total - completed;
+	unsigned int		queued    = total - completed - running;
+	unsigned long long	processedrows = total > 0 ? page->totalrows * completed / total : 0;
+
+	sprintf(text,
+			"\"%s\":{\"state\":\"%s\",\"scheduled\":%s,\"nodes\":3,\"totalSplits\":%u,\"queuedSplits\":%u,\"runningSplits\":%u,"
+			"\"completedSplits\":%u,\"userTimeMillis\":%u,\"cpuTimeMillis\":%u,\"wallTimeMillis\":%u,\"queuedTimeMillis\":%u,"
+			"\"elapsedTimeMillis\":%u,\"processedRows\":%llu,\"processedBytes\":%llu,\"peakMemoryBytes\":%llu",
+			name, page->state, strcmp(page->state, "QUEUED") == 0 ? "false" : "true", total, queued, running,
+			completed, completed * 31, completed * 37, completed * 53, 12,
+			completed * 19 + 12, processedrows, processedrows * 48, (unsigned long long)(running + 1) * 1048576ULL);
+
+	mockdata_appendstring(buffer, text);
+
+	if (withsubstages)
+	{
+		mockdata_append(buffer, ",", 1);
+		mockdata_stats(buffer, page, "rootStage", false);
+	}
+	else
+	{
+		mockdata_appendstring(buffer, ",\"stageId\":\"0\",\"done\":");
+		mockdata_appendstring(buffer, completed == total ? "true" : "false");
+		mockdata_appendstring(buffer, ",\"subStages\":[]");
+	}
+
+	mockdata_append(buffer, "}", 1);
+}
+
+void mockdata_response(MOCKBUFFER *buffer, const MOCKSHAPE *shape, const MOCKPAGE *page)
+{
+	unsigned int		c, r;
+
+	mockdata_appendstring(buffer, "{\"id\":\"");
+	mockdata_appendstring(buffer, page->id);
+	mockdata_appendstring(buffer, "\",\"infoUri\":\"");
+	mockdata_appendstring(buffer, page->baseurl);
+	mockdata_appendstring(buffer, "/v1/query/");
+	mockdata_appendstring(buffer, page->id);
+	mockdata_append(buffer, "\"", 1);
+
+	if (page->nexturi)
+	{
+		mockdata_appendstring(buffer, ",\"partialCancelUri\":\"");
+		mockdata_appendstring(buffer, page->baseurl);
+		mockdata_appendstring(buffer, "/v1/stage/");
+		mockdata_appendstring(buffer, page->id);
+		mockdata_appendstring(buffer, ".0\",\"nextUri\":\"");
+		mockdata_appendstring(buffer, page->nexturi);
+		mockdata_append(buffer, "\"", 1);
+	}
+
+	if (page->withcolumns)
+	{
+		mockdata_appendstring(buffer, ",\"columns\":[");
+
+		for (c = 0; c < shape->columns; c++)
+		{
+			char text[64];
+
+			sprintf(text, "%s{\"name\":\"c%u\",\"type\":\"%s\"}", c > 0 ? "," : "", c, mockdata_typename(shape->types[c]) );
+			mockdata_appendstring(buffer, text);
+		}
+
+		mockdata_append(buffer, "]", 1);
+	}
+
+	if (page->rowcount > 0)
+	{
+		mockdata_appendstring(buffer, ",\"data\":[");
+
+		for (r = 0; r < page->rowcount; r++)
+		{
+			mockdata_appendstring(buffer, r > 0 ? ",[" : "[");
+
+			for (c = 0; c < shape->columns; c++)
+			{
+				if (c > 0)
+					mockdata_append(buffer, ",", 1);
+
+				mockdata_value(buffer, shape, page->firstrow + r, c);
+			}
+
+			mockdata_append(buffer, "]", 1);
+		}
+
+		mockdata_append(buffer, "]", 1);
+	}
+
+	mockdata_append(buffer, ",", 1);
+	mockdata_stats(buffer, page, "stats", true);
+
+	if (page->errormessage)
+	{
+		mockdata_appendstring(buffer, ",\"error\":{\"message\":\"");
+		mockdata_appendstring(buffer, page->errormessage);
+		mockdata_appendstring(buffer, "\",\"errorCode\":1,\"errorName\":\"SYNTAX_ERROR\",\"failureInfo\":{\"type\":\"com.facebook.presto.sql.parser.ParsingException\",\"message\":\"");
+		mockdata_appendstring(buffer, page->errormessage);
+		mockdata_appendstring(buffer, "\",\"suppressed\":[],\"stack\":[\"com.facebook.presto.sql.parser.SqlParser.createStatement(SqlParser.java:47)\"]}}");
+	}
+
+	mockdata_append(buffer, "}", 1);
+}
@@ -0,0 +1,103 @@
+/*
+* This file is part of cPrestoClient
+*
+* Copyright (C) 2014 Ivo Herweijer
+*
+* cPrestoClient is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+* You can contact me via email: info@easydatawarehousing.com
+*/
+
+// Generator for synthetic Presto server responses. Used by the mock server and the benchmark tools.
+// Values are a function of row and column number, so every consumer can regenerate and verify them.
+
+#ifndef EASYPTORA_MOCKDATA_HH
+#define EASYPTORA_MOCKDATA_HH
+
+#include <stddef.h>
+
+#ifndef bool
+#define bool	signed char
+#define true	1
+#define false	0
+#endif
+
+#define MOCKDATA_MAX_COLUMNS 1024
+
+/* --- Enums ---------------------------------------------------------------------------------------------------------- */
+enum E_MOCKTYPES
+{
+	MOCK_TYPE_BIGINT = 0
+,	MOCK_TYPE_DOUBLE
+,	MOCK_TYPE_BOOLEAN
+,	MOCK_TYPE_VARCHAR
+,	MOCK_TYPE_DATE
+,	MOCK_TYPE_TIMESTAMP
+,	MOCK_TYPE_INTEGER
+,	MOCK_TYPE_REAL
+,	MOCK_TYPE_ARRAY
+,	MOCK_TYPE_MAP
+};
+
+/* --- Structs -------------------------------------------------------------------------------------------------------- */
+typedef struct ST_MOCKBUFFER
+{
+	char						 *data;							// Generated text, always null terminated
+	size_t						  size;							// Allocated size of data
+	size_t						  length;						// Length of text in data
+} MOCKBUFFER;
+
+typedef struct ST_MOCKSHAPE
+{
+	unsigned int				  columns;						// Number of columns
+	enum E_MOCKTYPES			  types[MOCKDATA_MAX_COLUMNS];	// Type of each column
+	unsigned int				  varcharlength;				// Approximate length of varchar values
+	unsigned int				  nullpercent;					// Percentage of values that is null
+	bool						  escapes;						// Put escape sequences and multibyte characters in varchars
+} MOCKSHAPE;
+
+typedef struct ST_MOCKPAGE
+{
+	const char					 *id;							// Query id
+	const char					 *baseurl;						// http://host:port
+	const char					 *nexturi;						// Uri of next page or NULL for the last page
+	const char					 *state;						// Server state: QUEUED, RUNNING, FINISHED, FAILED
+	bool						  withcolumns;					// Add the columns section
+	unsigned long long			  firstrow;						// Number of the first row in this page
+	unsigned int				  rowcount;						// Number of rows in this page (may be 0)
+	unsigned long long			  totalrows;					// Total number of rows of the query, used for stats
+	unsigned int				  totalsplits;					// Number of splits reported in stats
+	unsigned int				  completedsplits;				// Number of completed splits reported in stats
+	const char					 *errormessage;					// If not NULL an error section is added
+} MOCKPAGE;
+
+/* --- Functions ------------------------------------------------------------------------------------------------------ */
+extern void mockdata_init_buffer(MOCKBUFFER *buffer);
+extern void mockdata_free_buffer(MOCKBUFFER *buffer);
+extern void mockdata_append(MOCKBUFFER *buffer, const char *text, size_t length);
+extern void mockdata_appendstring(MOCKBUFFER *buffer, const char *text);
+
+// Parse a comma separated list of type names (bigint,double,boolean,varchar,date,timestamp). The list
+// is repeated until all columns have a type. Returns false for unknown type names.
+extern bool mockdata_set_types(MOCKSHAPE *shape, const char *typelist);
+
+// Add one value, as json text, for the given row and column
+extern void mockdata_value(MOCKBUFFER *buffer, const MOCKSHAPE *shape, unsigned long long row, unsigned int column);
+
+// Add a complete server response
+extern void mockdata_response(MOCKBUFFER *buffer, const MOCKSHAPE *shape, const MOCKPAGE *page);
+
+extern const char* mockdata_typename(enum E_MOCKTYPES type);
+
+#endif // EASYPTORA_MOCKDATA_HH
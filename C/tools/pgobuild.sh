@@ -0,0 +1,124 @@
+#!/bin/sh
+# This file is part of cPrestoClient
+# Copyright (C) 2014 Ivo Herweijer
+#
+# Profile guided optimization build of the prestoclient library and cprestoclient:
+#   1. build an instrumented tree (cmake -DPRESTOCLIENT_PGO=GENERATE)
+#   2. run the instrumented cprestoclient against prestomockserver for several result shapes
+#   3. rebuild the same tree with the recorded profile (cmake -DPRESTOCLIENT_PGO=USE)
+#   4. build a reference tree without PGO and compare both on the same workload
+#
+# Usage: tools/pgobuild.sh [builddir]          (default: _pgo_build)
+# The optimized cprestoclient and libraries are in builddir/pgo, the reference build in builddir/reference.
+# Set CC to choose the compiler (gcc or clang), ROWS and ITERATIONS to change the workload.
+
+set -e
+
+SOURCEDIR=$(cd "$(dirname "$0")/.." && pwd)
+BUILDDIR=${1:-_pgo_build}
+ROWS=${ROWS:-200000}
+ITERATIONS=${ITERATIONS:-5}
+
+mkdir -p "$BUILDDIR"
+BUILDDIR=$(cd "$BUILDDIR" && pwd)
+PROFILEDIR="$BUILDDIR/profile"
+
+# Result shapes of the workload: narrow numeric rows, wide varchar rows, escaped strings and mostly nulls
+SHAPES="narrow wide escaped nulls"
+
+shape_options()
+{
+	case "$1" in
+		narrow)  echo "--columns=4 --types=bigint,double,boolean,date" ;;
+		wide)    echo "--columns=40 --types=varchar,bigint,varchar,double --varchar-length=24" ;;
+		escaped) echo "--columns=8 --types=varchar --varchar-length=32 --escapes" ;;
+		nulls)   echo "--columns=16 --types=bigint,varchar,double,timestamp --null-percent=80" ;;
+	esac
+}
+
+# Start a mock server for a shape, sets MOCKPID and MOCKPORT
+start_mockserver()
+{
+	rm -f "$BUILDDIR/mockserver.log"
+	# Large pages keep the wait time between requests out of the measurement
+	"$BUILDDIR/pgo/prestomockserver" --port=0 --rows="$ROWS" --page-rows=50000 $(shape_options "$1") > "$BUILDDIR/mockserver.log" &
+	MOCKPID=$!
+
+	while ! grep -q "listening on" "$BUILDDIR/mockserver.log" 2>/dev/null
+	do
+		sleep 0.1
+	done
+
+	MOCKPORT=$(sed -n 's/.*:\([0-9]*\)$/\1/p' "$BUILDDIR/mockserver.log")
+}
+
+stop_mockserver()
+{
+	kill "$MOCKPID" 2>/dev/null || true
+	wait "$MOCKPID" 2>/dev/null || true
+}
+
+# Run a query with the given cprestoclient and print the parse time in seconds
+run_query()
+{
+	USER=${USER:-prestoclient} "$1" --port="$MOCKPORT" --sink=count localhost "select * from $2" 2>&1 >/dev/null |
+		sed -n 's/^Parse time: *\([0-9.]*\) s$/\1/p'
+}
+
+configure_and_build()
+{
+	cmake -S "$SOURCEDIR" -B "$1" -DCMAKE_BUILD_TYPE=Release "$2" "-DPRESTOCLIENT_PGO_DIR=$PROFILEDIR" > "$1.cmake.log" 2>&1
+	cmake --build "$1" > "$1.build.log" 2>&1
+}
+
+# 1. Instrumented build
+echo "Building instrumented tree"
+rm -rf "$PROFILEDIR"
+mkdir -p "$PROFILEDIR"
+configure_and_build "$BUILDDIR/pgo" -DPRESTOCLIENT_PGO=GENERATE
+
+# 2. Training run
+for SHAPE in $SHAPES
+do
+	echo "Training with shape $SHAPE"
+	start_mockserver "$SHAPE"
+	run_query "$BUILDDIR/pgo/cprestoclient" "$SHAPE" > /dev/null
+	stop_mockserver
+done
+
+# Clang writes raw profiles that have to be merged first
+if ls "$PROFILEDIR"/*.profraw > /dev/null 2>&1
+then
+	llvm-profdata merge -output="$PROFILEDIR/default.profdata" "$PROFILEDIR"/*.profraw
+fi
+
+# 3. Rebuild with the profile, in the same tree so the profile matches the object files
+echo "Building with profile"
+configure_and_build "$BUILDDIR/pgo" -DPRESTOCLIENT_PGO=USE
+
+# 4. Reference build and comparison, the fastest of all iterations is reported
+echo "Building reference tree"
+configure_and_build "$BUILDDIR/reference" -DPRESTOCLIENT_PGO=OFF
+
+printf "\n%-10s %14s %14s %9s\n" "Shape" "Reference (s)" "PGO (s)" "Speedup"
+
+for SHAPE in $SHAPES
+do
+	start_mockserver "$SHAPE"
+
+	BESTREFERENCE=999999
+	BESTPGO=999999
+	i=0
+	while [ $i -lt "$ITERATIONS" ]
+	do
+		REFERENCE=$(run_query "$BUILDDIR/reference/cprestoclient" "$SHAPE")
+		PGO=$(run_query "$BUILDDIR/pgo/cprestoclient" "$SHAPE")
+		BESTREFERENCE=$(echo "$BESTREFERENCE $REFERENCE" | awk '{ print ($2 < $1) ? $2 : $1 }')
+		BESTPGO=$(echo "$BESTPGO $PGO" | awk '{ print ($2 < $1) ? $2 : $1 }')
+		i=$((i + 1))
+	done
+
+	stop_mockserver
+
+	echo "$SHAPE $BESTREFERENCE $BESTPGO" | awk '{ printf "%-10s %14.3f %14.3f %8.2fx\n", $1, $2, $3, ($3 > 0) ? $2 / $3 : 0 }'
+done
@@ -0,0 +1,634 @@
+/*
+* This file is part of cPrestoClient
+*
+* Copyright (C) 2014 Ivo Herweijer
+*
+* cPrestoClient is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+* You can contact me via email: info@easydatawarehousing.com
+*/
+
+// prestomockserver: a stand-in for a Presto coordinator, used for offline benchmarks and tests.
+//
+// Implements the client protocol as described in README.md: POST /v1/statement starts a query, the client
+// follows the nextUri links until the last page. Result pages contain synthetic data (see mockdata.h),
+// the shape of the data, page size, latency, busy (503) responses and failures are set on the command line.
+// A query fails when its sql statement contains the word 'fail'.
+//
+// Page tokens in the nextUri links are page numbers, so the content of every page follows from the options.
+
+#include "mockdata.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+/* --- Defines -------------------------------------------------------------------------------------------------------- */
+#define MOCK_DEFAULT_PORT		8080
+#define MOCK_REQUEST_MAXSIZE	(1024 * 1024)
+#define MOCK_TOTAL_SPLITS		16
+
+/* --- Structs -------------------------------------------------------------------------------------------------------- */
+typedef struct ST_MOCKOPTIONS
+{
+	unsigned int				  port;							// TCP port to listen on, 0 picks a free port
+	const char					 *bind;							// Address to listen on
+	unsigned long long			  rows;							// Number of rows returned by every query
+	unsigned int				  pagerows;						// Number of rows per page
+	unsigned int				  latencymsec;					// Delay before every response
+	unsigned int				  queuedpolls;					// Number of pages in state QUEUED before data is returned
+	unsigned int				  busyevery;					// Every n-th GET request gets a 503 response, 0 = never
+	unsigned int				  failafter;					// Fail queries after this many data pages, 0 = never
+	unsigned int				  maxqueries;					// Exit after this many queries, 0 = run forever
+	bool						  verbose;						// Log requests to stderr
+	MOCKSHAPE					  shape;						// Shape of the generated data
+} MOCKOPTIONS;
+
+typedef struct ST_MOCKQUERY
+{
+	char						  id[64];						// Query id
+	bool						  fail;							// Query should fail
+	bool						  cancelled;					// Query was cancelled by the client
+	bool						  done;							// Last page was served
+} MOCKQUERY;
+
+typedef struct ST_MOCKREQUEST
+{
+	char						  method[16];
+	char						  path[1024];
+	char						 *body;
+	size_t						  bodylength;
+	bool						  keepalive;
+} MOCKREQUEST;
+
+/* --- Globals -------------------------------------------------------------------------------------------------------- */
+static MOCKOPTIONS				  options;						// Set once at startup, read-only afterwards
+static char						  baseurl[128];
+static MOCKQUERY				**queries      = NULL;
+static unsigned int				  querycount   = 0;
+static unsigned int				  donecount    = 0;
+static unsigned long long		  getcount     = 0;
+static pthread_mutex_t			  querylock    = PTHREAD_MUTEX_INITIALIZER;
+
+/* --- Query registry ------------------------------------------------------------------------------------------------- */
+static MOCKQUERY* new_query(const char *sql)
+{
+	MOCKQUERY	*query = (MOCKQUERY*)calloc(1, sizeof(MOCKQUERY) );
+	const char	*c;
+
+	if (!query)
+		exit(1);
+
+	for (c = sql; c && *c; c++)
+	{
+		if (strncasecmp(c, "fail", 4) == 0)
+			query->fail = true;
+	}
+
+	pthread_mutex_lock(&querylock);
+
+	sprintf(query->id, "20140101_000000_%05u_mock", querycount);
+
+	queries = (MOCKQUERY**)realloc(queries, (querycount + 1) * sizeof(MOCKQUERY*) );
+	if (!queries)
+		exit(1);
+
+	queries[querycount++] = query;
+
+	pthread_mutex_unlock(&querylock);
+
+	return query;
+}
+
+// Returns the query with this id (the path component following prefix) or NULL
+static MOCKQUERY* find_query(const char *path, const char *prefix)
+{
+	MOCKQUERY		*query = NULL;
+	size_t			 length;
+	unsigned int	 i;
+
+	if (strncmp(path, prefix, strlen(prefix) ) != 0)
+		return NULL;
+
+	path  += strlen(prefix);
+	length = strcspn(path, "/.?");
+
+	pthread_mutex_lock(&querylock);
+
+	for (i = 0; i < querycount; i++)
+	{
+		if (strlen(queries[i]->id) == length && strncmp(queries[i]->id, path, length) == 0)
+		{
+			query = queries[i];
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&querylock);
+
+	return query;
+}
+
+// Mark query as finished. Exits the server when the maximum number of queries is reached
+static bool finish_query(MOCKQUERY *query)
+{
+	bool exitserver = false;
+
+	pthread_mutex_lock(&querylock);
+
+	if (!query->done)
+	{
+		query->done = true;
+		donecount++;
+
+		if (options.maxqueries > 0 && donecount >= options.maxqueries)
+			exitserver = true;
+	}
+
+	pthread_mutex_unlock(&querylock);
+
+	return exitserver;
+}
+
+/* --- HTTP ----------------------------------------------------------------------------------------------------------- */
+static bool send_fully(int fd, const char *data, size_t length)
+{
+	ssize_t sent;
+
+	while (length > 0)
+	{
+		sent = send(fd, data, length, MSG_NOSIGNAL);
+
+		if (sent < 0)
+		{
+			if (errno == EINTR)
+				continue;
+
+			return false;
+		}
+
+		data   += sent;
+		length -= (size_t)sent;
+	}
+
+	return true;
+}
+
+static bool send_response(int fd, int status, const char *reason, const MOCKBUFFER *body, bool keepalive)
+{
+	char header[256];
+
+	sprintf(header, "HTTP/1.1 %d %s\r\nContent-Type: application/json\r\nContent-Length: %lu\r\n%s\r\n",
+			status, reason, body ? (unsigned long)body->length : 0UL, keepalive ? "" : "Connection: close\r\n");
+
+	if (!send_fully(fd, header, strlen(header) ) )
+		return false;
+
+	return (body ? send_fully(fd, body->data, body->length) : true);
+}
+
+// Read one request from the connection. Bytes read beyond the request are kept in buffer
+static bool read_request(int fd, MOCKBUFFER *buffer, MOCKREQUEST *request)
+{
+	char		 chunk[16384], *headerend, *line, *value;
+	ssize_t		 received;
+	size_t		 headerlength, contentlength = 0;
+
+	// Read until the end of the headers
+	while ( (headerend = strstr(buffer->data, "\r\n\r\n") ) == NULL)
+	{
+		if (buffer->length > MOCK_REQUEST_MAXSIZE)
+			return false;
+
+		received = recv(fd, chunk, sizeof(chunk), 0);
+
+		if (received < 0 && errno == EINTR)
+			continue;
+
+		if (received <= 0)
+			return false;
+
+		mockdata_append(buffer, chunk, (size_t)received);
+	}
+
+	headerlength = (size_t)(headerend - buffer->data) + 4;
+
+	// Request line
+	if (sscanf(buffer->data, "%15s %1023s", request->method, request->path) != 2)
+		return false;
+
+	// Headers we care about
+	request->keepalive = true;
+	line = strstr(buffer->data, "\r\n");
+
+	while (line && line < headerend)
+	{
+		line += 2;
+		value = strchr(line, ':');
+
+		if (value && value < headerend)
+		{
+			if (strncasecmp(line, "Content-Length:", 15) == 0)
+				contentlength = strtoul(value + 1, NULL, 10);
+			else if (strncasecmp(line, "Connection:", 11) == 0 && strncasecmp(value + 1 + strspn(value + 1, " "), "close", 5) == 0)
+				request->keepalive = false;
+		}
+
+		line = strstr(line, "\r\n");
+	}
+
+	if (contentlength > MOCK_REQUEST_MAXSIZE)
+		return false;
+
+	// Body
+	while (buffer->length < headerlength + contentlength)
+	{
+		received = recv(fd, chunk, sizeof(chunk), 0);
+
+		if (received < 0 && errno == EINTR)
+			continue;
+
+		if (received <= 0)
+			return false;
+
+		mockdata_append(buffer, chunk, (size_t)received);
+	}
+
+	request->body = (char*)malloc(contentlength + 1);
+	if (!request->body)
+		exit(1);
+
+	memcpy(request->body, buffer->data + headerlength, contentlength);
+	request->body[contentlength] = 0;
+	request->bodylength = contentlength;
+
+	// Keep whatever follows this request
+	memmove(buffer->data, buffer->data + headerlength + contentlength, buffer->length - headerlength - contentlength + 1);
+	buffer->length -= headerlength + contentlength;
+
+	return true;
+}
+
+static void sleep_msec(unsigned int msec)
+{
+	struct timespec ts;
+
+	ts.tv_sec  = msec / 1000;
+	ts.tv_nsec = (long)(msec % 1000) * 1000000L;
+
+	while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+		;
+}
+
+/* --- Protocol ------------------------------------------------------------------------------------------------------- */
+// Build the response for page 'token' of a query. Returns true if this is the last page
+static bool build_page(MOCKBUFFER *body, MOCKQUERY *query, unsigned int token)
+{
+	MOCKPAGE			page;
+	char				nexturi[256];
+	unsigned long long	totalpages, datapage;
+	bool				last = false;
+
+	totalpages = (options.rows + options.pagerows - 1) / options.pagerows;
+	if (totalpages == 0)
+		totalpages = 1;
+
+	memset(&page, 0, sizeof(MOCKPAGE) );
+	page.id          = query->id;
+	page.baseurl     = baseurl;
+	page.totalrows   = options.rows;
+	page.totalsplits = MOCK_TOTAL_SPLITS;
+
+	sprintf(nexturi, "%s/v1/statement/%s/%u", baseurl, query->id, token + 1);
+
+	if (token <= options.queuedpolls)
+	{
+		// Waiting for the query to start
+		page.state   = "QUEUED";
+		page.nexturi = nexturi;
+	}
+	else
+	{
+		datapage = token - options.queuedpolls - 1;
+
+		page.withcolumns     = true;
+		page.completedsplits = (unsigned int)(MOCK_TOTAL_SPLITS * (datapage + 1 < totalpages ? datapage + 1 : totalpages) / totalpages);
+
+		if (query->cancelled)
+		{
+			page.withcolumns  = false;
+			page.state        = "FAILED";
+			page.errormessage = "Query was canceled";
+			last = true;
+		}
+		else if (query->fail || (options.failafter > 0 && datapage >= options.failafter) )
+		{
+			page.withcolumns  = query->fail ? false : true;
+			page.state        = "FAILED";
+			page.errormessage = "line 1:1: mock failure";
+			last = true;
+		}
+		else if (datapage >= totalpages)
+		{
+			page.state = "FINISHED";
+			last = true;
+		}
+		else
+		{
+			page.firstrow = datapage * options.pagerows;
+			page.rowcount = (unsigned int)(options.rows - page.firstrow < options.pagerows ? options.rows - page.firstrow : options.pagerows);
+
+			if (datapage + 1 < totalpages)
+			{
+				page.state   = "RUNNING";
+				page.nexturi = nexturi;
+			}
+			else
+			{
+				page.state = "FINISHED";
+				last = true;
+			}
+		}
+	}
+
+	mockdata_response(body, &options.shape, &page);
+
+	return last;
+}
+
+// Handle one request. Returns false if the connection should be closed
+static bool handle_request(int fd, MOCKREQUEST *request)
+{
+	MOCKBUFFER		 body;
+	MOCKQUERY		*query;
+	const char		*tokenstart;
+	unsigned int	 token;
+	bool			 busy, last, exitserver = false, success;
+
+	mockdata_init_buffer(&body);
+
+	if (options.verbose)
+		fprintf(stderr, "%s %s\n", request->method, request->path);
+
+	if (options.latencymsec > 0)
+		sleep_msec(options.latencymsec);
+
+	if (strcmp(request->method, "POST") == 0 && strcmp(request->path, "/v1/statement") == 0)
+	{
+		// Start a query
+		query = new_query(request->body);
+		build_page(&body, query, 0);
+		success = send_response(fd, 200, "OK", &body, request->keepalive);
+	}
+	else if (strcmp(request->method, "GET") == 0 && (query = find_query(request->path, "/v1/statement/") ) != NULL)
+	{
+		// Next page
+		pthread_mutex_lock(&querylock);
+		getcount++;
+		busy = (options.busyevery > 0 && getcount % options.busyevery == 0);
+		pthread_mutex_unlock(&querylock);
+
+		tokenstart = strrchr(request->path, '/');
+		token      = (unsigned int)strtoul(tokenstart + 1, NULL, 10);
+
+		if (busy)
+		{
+			success = send_response(fd, 503, "Service Unavailable", NULL, request->keepalive);
+		}
+		else
+		{
+			last       = build_page(&body, query, token);
+			success    = send_response(fd, 200, "OK", &body, request->keepalive);
+			exitserver = last && finish_query(query);
+		}
+	}
+	else if (strcmp(request->method, "GET") == 0 && (query = find_query(request->path, "/v1/query/") ) != NULL)
+	{
+		// Query info
+		mockdata_appendstring(&body, "{\"queryId\":\"");
+		mockdata_appendstring(&body, query->id);
+		mockdata_appendstring(&body, "\",\"state\":\"");
+		mockdata_appendstring(&body, query->done ? (query->cancelled || query->fail ? "FAILED" : "FINISHED") : "RUNNING");
+		mockdata_appendstring(&body, "\"}");
+		success = send_response(fd, 200, "OK", &body, request->keepalive);
+	}
+	else if (strcmp(request->method, "DELETE") == 0 &&
+			 ( (query = find_query(request->path, "/v1/stage/") ) != NULL ||
+			   (query = find_query(request->path, "/v1/statement/") ) != NULL ||
+			   (query = find_query(request->path, "/v1/query/") ) != NULL) )
+	{
+		// Cancel
+		pthread_mutex_lock(&querylock);
+		query->cancelled = true;
+		pthread_mutex_unlock(&querylock);
+		success    = send_response(fd, 204, "No Content", NULL, request->keepalive);
+		exitserver = finish_query(query);
+	}
+	else
+	{
+		mockdata_appendstring(&body, "{\"message\":\"Not found\"}");
+		success = send_response(fd, 404, "Not Found", &body, request->keepalive);
+	}
+
+	mockdata_free_buffer(&body);
+
+	if (exitserver)
+	{
+		if (options.verbose)
+			fprintf(stderr, "Served %u queries, exiting\n", options.maxqueries);
+
+		exit(0);
+	}
+
+	return success && request->keepalive;
+}
+
+static void* connection_thread(void *in_fd)
+{
+	int			fd = (int)(long)in_fd;
+	MOCKBUFFER	buffer;
+	MOCKREQUEST	request;
+	bool		keepopen = true;
+
+	mockdata_init_buffer(&buffer);
+
+	while (keepopen && read_request(fd, &buffer, &request) )
+	{
+		keepopen = handle_request(fd, &request);
+		free(request.body);
+	}
+
+	mockdata_free_buffer(&buffer);
+	close(fd);
+
+	return NULL;
+}
+
+/* --- Main ----------------------------------------------------------------------------------------------------------- */
+static void print_usage()
+{
+	printf("Usage: prestomockserver [options]\n");
+	printf("Options:\n");
+	printf("  --port=<n>            TCP port to listen on, 0 picks a free port (default %d)\n", MOCK_DEFAULT_PORT);
+	printf("  --bind=<address>      Address to listen on (default 127.0.0.1)\n");
+	printf("  --rows=<n>            Number of rows returned by every query (default 10000)\n");
+	printf("  --page-rows=<n>       Number of rows per page (default 1000)\n");
+	printf("  --columns=<n>         Number of columns (default 4)\n");
+	printf("  --types=<list>        Column types, repeated for all columns (default bigint,varchar,double,boolean)\n");
+	printf("                        Types: bigint,double,boolean,varchar,date,timestamp,integer,real,array,map\n");
+	printf("  --varchar-length=<n>  Average length of varchar values (default 16)\n");
+	printf("  --null-percent=<n>    Percentage of null values (default 0)\n");
+	printf("  --escapes             Put escape sequences and multibyte characters in varchar values\n");
+	printf("  --latency=<msec>      Delay before every response (default 0)\n");
+	printf("  --queued-polls=<n>    Number of polls answered with state QUEUED before data is sent (default 1)\n");
+	printf("  --busy-every=<n>      Respond with 503 to every n-th GET request (default never)\n");
+	printf("  --fail-after=<n>      Fail every query after n data pages (default never)\n");
+	printf("  --max-queries=<n>     Exit after n queries have finished (default run forever)\n");
+	printf("  --verbose             Log requests to stderr\n");
+	printf("Queries fail immediately when the sql statement contains the word 'fail'.\n");
+}
+
+static bool parse_options(int argc, char **argv)
+{
+	const char	*types = "bigint,varchar,double,boolean";
+	int			 i;
+
+	memset(&options, 0, sizeof(MOCKOPTIONS) );
+	options.port                = MOCK_DEFAULT_PORT;
+	options.bind                = "127.0.0.1";
+	options.rows                = 10000;
+	options.pagerows            = 1000;
+	options.queuedpolls         = 1;
+	options.shape.columns       = 4;
+	options.shape.varcharlength = 16;
+
+	for (i = 1; i < argc; i++)
+	{
+		if      (strncmp(argv[i], "--port=",           7) == 0)	options.port                = (unsigned int)strtoul(argv[i] +  7, NULL, 10);
+		else if (strncmp(argv[i], "--bind=",           7) == 0)	options.bind                = argv[i] + 7;
+		else if (strncmp(argv[i], "--rows=",           7) == 0)	options.rows                = strtoull(argv[i] + 7, NULL, 10);
+		else if (strncmp(argv[i], "--page-rows=",     12) == 0)	options.pagerows            = (unsigned int)strtoul(argv[i] + 12, NULL, 10);
+		else if (strncmp(argv[i], "--columns=",       10) == 0)	options.shape.columns       = (unsigned int)strtoul(argv[i] + 10, NULL, 10);
+		else if (strncmp(argv[i], "--types=",          8) == 0)	types                       = argv[i] + 8;
+		else if (strncmp(argv[i], "--varchar-length=",17) == 0)	options.shape.varcharlength = (unsigned int)strtoul(argv[i] + 17, NULL, 10);
+		else if (strncmp(argv[i], "--null-percent=",  15) == 0)	options.shape.nullpercent   = (unsigned int)strtoul(argv[i] + 15, NULL, 10);
+		else if (strcmp (argv[i], "--escapes")            == 0)	options.shape.escapes       = true;
+		else if (strncmp(argv[i], "--latency=",       10) == 0)	options.latencymsec         = (unsigned int)strtoul(argv[i] + 10, NULL, 10);
+		else if (strncmp(argv[i], "--queued-polls=",  15) == 0)	options.queuedpolls         = (unsigned int)strtoul(argv[i] + 15, NULL, 10);
+		else if (strncmp(argv[i], "--busy-every=",    13) == 0)	options.busyevery           = (unsigned int)strtoul(argv[i] + 13, NULL, 10);
+		else if (strncmp(argv[i], "--fail-after=",    13) == 0)	options.failafter           = (unsigned int)strtoul(argv[i] + 13, NULL, 10);
+		else if (strncmp(argv[i], "--max-queries=",   14) == 0)	options.maxqueries          = (unsigned int)strtoul(argv[i] + 14, NULL, 10);
+		else if (strcmp (argv[i], "--verbose")            == 0)	options.verbose             = true;
+		else
+		{
+			printf("Unknown option '%s'\n", argv[i]);
+			return false;
+		}
+	}
+
+	if (options.pagerows == 0 || options.shape.columns == 0 || options.shape.columns > MOCKDATA_MAX_COLUMNS || options.port > 65535)
+		return false;
+
+	if (!mockdata_set_types(&options.shape, types) )
+	{
+		printf("Invalid type list '%s'\n", types);
+		return false;
+	}
+
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	int					listenfd, fd, on = 1;
+	struct sockaddr_in	address;
+	socklen_t			addresslength;
+	pthread_t			thread;
+	pthread_attr_t		attributes;
+
+	if (!parse_options(argc, argv) )
+	{
+		print_usage();
+		exit(1);
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+
+	listenfd = socket(AF_INET, SOCK_STREAM, 0);
+	if (listenfd < 0)
+	{
+		perror("socket");
+		exit(1);
+	}
+
+	setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on) );
+
+	memset(&address, 0, sizeof(address) );
+	address.sin_family = AF_INET;
+	address.sin_port   = htons( (unsigned short)options.port);
+
+	if (inet_pton(AF_INET, options.bind, &address.sin_addr) != 1)
+	{
+		printf("Invalid bind address '%s'\n", options.bind);
+		exit(1);
+	}
+
+	if (bind(listenfd, (struct sockaddr*)&address, sizeof(address) ) != 0 || listen(listenfd, 128) != 0)
+	{
+		perror("bind");
+		exit(1);
+	}
+
+	// Report the port, needed when a free port was picked
+	addresslength = sizeof(address);
+	getsockname(listenfd, (struct sockaddr*)&address, &addresslength);
+	sprintf(baseurl, "http://%s:%u", options.bind, (unsigned int)ntohs(address.sin_port) );
+
+	printf("prestomockserver listening on %s\n", baseurl);
+	fflush(stdout);
+
+	pthread_attr_init(&attributes);
+	pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+
+	for (;;)
+	{
+		fd = accept(listenfd, NULL, NULL);
+
+		if (fd < 0)
+		{
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+
+			perror("accept");
+			exit(1);
+		}
+
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on) );
+
+		if (pthread_create(&thread, &attributes, connection_thread, (void*)(long)fd) != 0)
+			close(fd);
+	}
+
+	return 0;
+}
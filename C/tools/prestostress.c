@@ -0,0 +1,431 @@
+/*
+* This file is part of cPrestoClient
+*
+* Copyright (C) 2014 Ivo Herweijer
+*
+* cPrestoClient is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+* You can contact me via email: info@easydatawarehousing.com
+*/
+
+// prestostress: runs many queries at the same time from many threads, all sharing one PRESTOCLIENT.
+//
+// Meant to be run against prestomockserver, which returns the same result for every query. Every query
+// computes a hash over all values it received; all queries must succeed with the same number of rows and
+// the same hash. Build with PRESTOCLIENT_SANITIZERS=thread to let TSan check the client as well:
+//
+//	prestomockserver --port=18080 --rows=5000 &
+//	prestostress --port=18080 --threads=100 --queries=5
+//
+// With --cancel-after every query is cancelled from a second thread instead, some time after the first response
+// arrived. The time from the cancel until prestoclient_query returns must stay below --max-cancel-latency. Use a
+// mock server with a high latency, so the cancel hits a running request:
+//
+//	prestomockserver --port=18080 --rows=5000 --page-rows=100 --latency=2000 &
+//	prestostress --port=18080 --threads=20 --queries=2 --cancel-after=100
+
+#include "prestoclient.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <errno.h>
+
+#ifndef bool
+#define bool	signed char
+#define true	1
+#define false	0
+#endif
+
+/* --- Defines -------------------------------------------------------------------------------------------------------- */
+#define STRESS_MAX_THREADS		1024
+
+/* --- Structs -------------------------------------------------------------------------------------------------------- */
+typedef struct ST_STRESSOPTIONS
+{
+	const char					 *server;						// Server name
+	unsigned int				  port;							// TCP port of the server
+	const char					 *sql;							// Statement sent by every query
+	unsigned int				  threads;						// Number of threads
+	unsigned int				  queries;						// Number of queries per thread
+	unsigned long long			  rows;							// Expected number of rows per query, 0 = don't check
+	unsigned int				  cancelafter;					// Millisec after the first response to cancel, 0 = don't cancel
+	unsigned int				  maxcancellatency;				// Maximum millisec from the cancel until the query returns
+} STRESSOPTIONS;
+
+typedef struct ST_STRESSQUERY
+{
+	unsigned long long			  rows;							// Rows received
+	unsigned long long			  hash;							// FNV-1a hash of all values received
+	PRESTOCLIENT_RESULT			 *result;						// Set by the first progress callback, used by the cancel thread
+	bool						  done;							// Set when prestoclient_query returned
+	double						  canceltime;					// Time the cancel thread cancelled the query, 0 = not cancelled
+	pthread_mutex_t				  lock;							// Protects result, done and canceltime
+	pthread_cond_t				  changed;						// Signalled when result or done is set
+} STRESSQUERY;
+
+typedef struct ST_STRESSTHREAD
+{
+	pthread_t					  thread;
+	unsigned int				  number;						// Thread number, used in messages
+	unsigned int				  succeeded;					// Queries that succeeded with the expected result
+	unsigned int				  failed;						// Queries that failed or returned a different result
+	unsigned long long			  rows;							// Rows received by all queries of this thread
+	unsigned int				  cancelled;					// Queries cancelled by the cancel thread
+	double						  maxcancellatency;				// Longest time from a cancel until the query returned
+	double						  sumcancellatency;				// Sum of these times of all cancelled queries
+} STRESSTHREAD;
+
+/* --- Globals -------------------------------------------------------------------------------------------------------- */
+static STRESSOPTIONS				  options;
+static PRESTOCLIENT					 *client;						// Shared by all threads
+static pthread_mutex_t				  resultlock = PTHREAD_MUTEX_INITIALIZER;
+static bool							  haveresult = false;			// Set by the first query that finished
+static STRESSQUERY					  firstresult;					// Result all other queries are compared with
+
+/* --- Functions ------------------------------------------------------------------------------------------------------ */
+static double get_time()
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+static unsigned long long add_hash(unsigned long long hash, const char *data, unsigned int length)
+{
+	unsigned int i;
+
+	for (i = 0; i < length; i++)
+		hash = (hash ^ (unsigned char)data[i]) * 1099511628211ULL;
+
+	return hash;
+}
+
+static void write_callback(void *in_query, void *in_result)
+{
+	STRESSQUERY			*query  = (STRESSQUERY*)in_query;
+	PRESTOCLIENT_RESULT	*result = (PRESTOCLIENT_RESULT*)in_result;
+	unsigned int		 i, columns;
+
+	columns = prestoclient_getcolumncount(result);
+
+	for (i = 0; i < columns; i++)
+	{
+		if (prestoclient_getnullcolumnvalue(result, i) )
+			query->hash = add_hash(query->hash, "\x01", 1);
+		else
+			query->hash = add_hash(query->hash, prestoclient_getcolumndata(result, i), prestoclient_getcolumndatalength(result, i) );
+
+		query->hash = add_hash(query->hash, "\x00", 1);
+	}
+
+	query->rows++;
+}
+
+// Remembers the result handle for the cancel thread
+static void progress_callback(void *in_query, void *in_result)
+{
+	STRESSQUERY *query = (STRESSQUERY*)in_query;
+
+	pthread_mutex_lock(&query->lock);
+
+	if (!query->result)
+	{
+		query->result = (PRESTOCLIENT_RESULT*)in_result;
+		pthread_cond_signal(&query->changed);
+	}
+
+	pthread_mutex_unlock(&query->lock);
+}
+
+// Cancels the query options.cancelafter millisec after the first response, unless it finished before that
+static void* cancel_thread(void *in_query)
+{
+	STRESSQUERY		*query = (STRESSQUERY*)in_query;
+	struct timespec	 deadline;
+	int				 status = 0;
+
+	pthread_mutex_lock(&query->lock);
+
+	while (!query->result && !query->done)
+		pthread_cond_wait(&query->changed, &query->lock);
+
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec  += options.cancelafter / 1000;
+	deadline.tv_nsec += (long)(options.cancelafter % 1000) * 1000000L;
+
+	if (deadline.tv_nsec >= 1000000000L)
+	{
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000L;
+	}
+
+	while (!query->done && status != ETIMEDOUT)
+		status = pthread_cond_timedwait(&query->changed, &query->lock, &deadline);
+
+	if (!query->done)
+	{
+		query->canceltime = get_time();
+		prestoclient_cancelquery(query->result);
+	}
+
+	pthread_mutex_unlock(&query->lock);
+
+	return NULL;
+}
+
+// Returns true when the query was cancelled and returned within options.maxcancellatency millisec
+static bool check_cancel(STRESSTHREAD *thread, PRESTOCLIENT_RESULT *result, const STRESSQUERY *query, double returntime)
+{
+	double latency;
+
+	if (query->canceltime == 0.0)
+	{
+		printf("Thread %u: query finished before it was cancelled, use a mock server with a higher --latency\n", thread->number);
+		return false;
+	}
+
+	latency = returntime - query->canceltime;
+	thread->cancelled++;
+
+	if (latency > thread->maxcancellatency)
+		thread->maxcancellatency = latency;
+
+	thread->sumcancellatency += latency;
+
+	if (!result || prestoclient_getstatus(result) != PRESTOCLIENT_STATUS_FAILED)
+	{
+		printf("Thread %u: cancelled query did not fail\n", thread->number);
+		return false;
+	}
+
+	if (latency * 1000.0 > options.maxcancellatency)
+	{
+		printf("Thread %u: query returned %.1f ms after the cancel, expected at most %u ms\n", thread->number,
+				latency * 1000.0, options.maxcancellatency);
+		return false;
+	}
+
+	return true;
+}
+
+// Returns true when the query succeeded with the same result as all other queries
+static bool check_query(STRESSTHREAD *thread, PRESTOCLIENT_RESULT *result, const STRESSQUERY *query)
+{
+	bool ok = true;
+
+	if (!result || prestoclient_getstatus(result) != PRESTOCLIENT_STATUS_SUCCEEDED)
+	{
+		printf("Thread %u: query failed: %s %s %s\n", thread->number,
+				result && prestoclient_getlastservererror(result) ? prestoclient_getlastservererror(result) : "",
+				result && prestoclient_getlastclienterror(result) ? prestoclient_getlastclienterror(result) : "",
+				result && prestoclient_getlastcurlerror(result)   ? prestoclient_getlastcurlerror(result)   : "");
+		return false;
+	}
+
+	if (options.rows > 0 && query->rows != options.rows)
+	{
+		printf("Thread %u: received %llu rows, expected %llu\n", thread->number, query->rows, options.rows);
+		return false;
+	}
+
+	pthread_mutex_lock(&resultlock);
+
+	if (!haveresult)
+	{
+		firstresult = *query;
+		haveresult  = true;
+	}
+	else if (query->rows != firstresult.rows || query->hash != firstresult.hash)
+	{
+		printf("Thread %u: result differs (%llu rows, hash %016llx instead of %llu rows, hash %016llx)\n", thread->number,
+				query->rows, query->hash, firstresult.rows, firstresult.hash);
+		ok = false;
+	}
+
+	pthread_mutex_unlock(&resultlock);
+
+	return ok;
+}
+
+static void* stress_thread(void *in_thread)
+{
+	STRESSTHREAD		*thread = (STRESSTHREAD*)in_thread;
+	PRESTOCLIENT_RESULT	*result;
+	STRESSQUERY			 query;
+	pthread_t			 canceller;
+	unsigned int		 i;
+	double				 returntime;
+	bool				 ok;
+
+	for (i = 0; i < options.queries; i++)
+	{
+		query.rows       = 0;
+		query.hash       = 14695981039346656037ULL;
+		query.result     = NULL;
+		query.done       = false;
+		query.canceltime = 0.0;
+		pthread_mutex_init(&query.lock, NULL);
+		pthread_cond_init(&query.changed, NULL);
+
+		if (options.cancelafter > 0 && pthread_create(&canceller, NULL, &cancel_thread, (void*)&query) != 0)
+		{
+			printf("Thread %u: could not start cancel thread\n", thread->number);
+			exit(1);
+		}
+
+		result     = prestoclient_query(client, options.sql, NULL, &write_callback, NULL, (void*)&query);
+		returntime = get_time();
+
+		if (options.cancelafter > 0)
+		{
+			pthread_mutex_lock(&query.lock);
+			query.done = true;
+			pthread_cond_signal(&query.changed);
+			pthread_mutex_unlock(&query.lock);
+			pthread_join(canceller, NULL);
+
+			ok = check_cancel(thread, result, &query, returntime);
+		}
+		else
+			ok = check_query(thread, result, &query);
+
+		pthread_cond_destroy(&query.changed);
+		pthread_mutex_destroy(&query.lock);
+
+		if (ok)
+			thread->succeeded++;
+		else
+			thread->failed++;
+
+		thread->rows += query.rows;
+	}
+
+	return NULL;
+}
+
+static void print_usage()
+{
+	printf("Usage: prestostress [options] [servername]\n");
+	printf("Runs queries from many threads at the same time, sharing one client, and checks that all results are equal.\n");
+	printf("Options:\n");
+	printf("  --port=<n>            TCP port of the Presto server (default %d)\n", PRESTOCLIENT_DEFAULT_PORT);
+	printf("  --threads=<n>         Number of threads (default 50, maximum %d)\n", STRESS_MAX_THREADS);
+	printf("  --queries=<n>         Number of queries per thread (default 4)\n");
+	printf("  --rows=<n>            Expected number of rows per query (default don't check)\n");
+	printf("  --sql=<statement>     Statement to run (default 'select * from stress')\n");
+	printf("  --cancel-after=<msec> Cancel every query from another thread this long after its first response,\n");
+	printf("                        and check how fast it returns (default 0, don't cancel)\n");
+	printf("  --max-cancel-latency=<msec>  Maximum time from the cancel until the query returns (default 250)\n");
+}
+
+static bool parse_options(int argc, char **argv)
+{
+	int i;
+
+	memset(&options, 0, sizeof(STRESSOPTIONS) );
+	options.server  = "localhost";
+	options.port    = PRESTOCLIENT_DEFAULT_PORT;
+	options.sql     = "select * from stress";
+	options.threads = 50;
+	options.queries = 4;
+	options.maxcancellatency = 250;
+
+	for (i = 1; i < argc; i++)
+	{
+		if      (strncmp(argv[i], "--port=",     7) == 0)	options.port    = (unsigned int)strtoul(argv[i] +  7, NULL, 10);
+		else if (strncmp(argv[i], "--threads=", 10) == 0)	options.threads = (unsigned int)strtoul(argv[i] + 10, NULL, 10);
+		else if (strncmp(argv[i], "--queries=", 10) == 0)	options.queries = (unsigned int)strtoul(argv[i] + 10, NULL, 10);
+		else if (strncmp(argv[i], "--rows=",     7) == 0)	options.rows    = strtoull(argv[i] + 7, NULL, 10);
+		else if (strncmp(argv[i], "--sql=",      6) == 0)	options.sql     = argv[i] + 6;
+		else if (strncmp(argv[i], "--cancel-after=",       15) == 0)	options.cancelafter      = (unsigned int)strtoul(argv[i] + 15, NULL, 10);
+		else if (strncmp(argv[i], "--max-cancel-latency=", 21) == 0)	options.maxcancellatency = (unsigned int)strtoul(argv[i] + 21, NULL, 10);
+		else if (strncmp(argv[i], "--", 2) != 0)			options.server  = argv[i];
+		else
+		{
+			printf("Unknown option '%s'\n", argv[i]);
+			return false;
+		}
+	}
+
+	return options.threads > 0 && options.threads <= STRESS_MAX_THREADS;
+}
+
+int main(int argc, char **argv)
+{
+	static STRESSTHREAD	threads[STRESS_MAX_THREADS];
+	unsigned int		i, succeeded = 0, failed = 0, cancelled = 0;
+	unsigned long long	rows = 0;
+	double				starttime, elapsed, maxcancellatency = 0.0, sumcancellatency = 0.0;
+
+	if (!parse_options(argc, argv) )
+	{
+		print_usage();
+		exit(1);
+	}
+
+	client = prestoclient_init(options.server, &options.port, NULL, NULL, NULL, NULL, NULL);
+
+	if (!client)
+	{
+		printf("Could not initialize prestoclient\n");
+		exit(1);
+	}
+
+	if (options.cancelafter > 0)
+		prestoclient_setprogresscallback(client, &progress_callback);
+
+	starttime = get_time();
+
+	for (i = 0; i < options.threads; i++)
+	{
+		threads[i].number = i;
+
+		if (pthread_create(&threads[i].thread, NULL, &stress_thread, (void*)&threads[i]) != 0)
+		{
+			printf("Could not start thread %u\n", i);
+			exit(1);
+		}
+	}
+
+	for (i = 0; i < options.threads; i++)
+	{
+		pthread_join(threads[i].thread, NULL);
+
+		succeeded += threads[i].succeeded;
+		failed    += threads[i].failed;
+		rows      += threads[i].rows;
+		cancelled += threads[i].cancelled;
+		sumcancellatency += threads[i].sumcancellatency;
+
+		if (threads[i].maxcancellatency > maxcancellatency)
+			maxcancellatency = threads[i].maxcancellatency;
+	}
+
+	elapsed = get_time() - starttime;
+
+	prestoclient_close(client);
+
+	printf("%u threads, %u queries, %u failed, %llu rows, %.2f s, %.1f queries/s\n",
+			options.threads, succeeded + failed, failed, rows, elapsed, elapsed > 0.0 ? (succeeded + failed) / elapsed : 0.0);
+
+	if (options.cancelafter > 0)
+		printf("%u queries cancelled, latency %.1f ms average, %.1f ms maximum\n", cancelled,
+				cancelled > 0 ? sumcancellatency * 1000.0 / cancelled : 0.0, maxcancellatency * 1000.0);
+
+	return failed > 0 ? 1 : 0;
+}
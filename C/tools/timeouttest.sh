@@ -0,0 +1,46 @@
+#!/bin/sh
+# This file is part of cPrestoClient
+# Copyright (C) 2014 Ivo Herweijer
+#
+# Checks that cprestoclient --timeout also cancels the request that starts the query. The mock server answers
+# every request after LATENCY milliseconds, a timeout of 1 second must end the query well before the answer
+# to the first request arrives.
+#
+# Usage: tools/timeouttest.sh <builddir>          (run by ctest)
+
+set -e
+
+BUILDDIR=$(cd "${1:-.}" && pwd)
+LATENCY=${LATENCY:-3000}
+LOGFILE="$BUILDDIR/timeouttest.log"
+
+rm -f "$LOGFILE"
+"$BUILDDIR/prestomockserver" --port=0 --rows=100 --latency="$LATENCY" > "$LOGFILE" &
+MOCKPID=$!
+trap 'kill "$MOCKPID" 2>/dev/null || true' EXIT
+
+while ! grep -q "listening on" "$LOGFILE" 2>/dev/null
+do
+	sleep 0.1
+done
+
+MOCKPORT=$(sed -n 's/.*:\([0-9]*\)$/\1/p' "$LOGFILE")
+
+# cprestoclient reports the time of a query that was cancelled by the timeout
+OUTPUT=$(USER=${USER:-prestoclient} "$BUILDDIR/cprestoclient" --port="$MOCKPORT" --timeout=1 localhost "select 1" 2>&1 || true)
+ELAPSED=$(echo "$OUTPUT" | sed -n 's/^Query cancelled after \([0-9.]*\) seconds$/\1/p')
+
+if [ -z "$ELAPSED" ]
+then
+	echo "Query was not cancelled by the timeout:"
+	echo "$OUTPUT"
+	exit 1
+fi
+
+if ! echo "$ELAPSED $LATENCY" | awk '{ exit ($1 < 1.5 && $1 * 1000 < $2) ? 0 : 1 }'
+then
+	echo "Query was cancelled after $ELAPSED seconds, expected about 1 second (server latency $LATENCY ms)"
+	exit 1
+fi
+
+echo "Query was cancelled after $ELAPSED seconds"
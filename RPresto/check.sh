@@ -0,0 +1,37 @@
+#!/bin/sh
+# Copyright 2013 Ivo Herweijer | easydatawarehousing.com
+#
+# Runs R CMD check on RPresto, which also runs the tests in directory tests:
+#   1. the package as installed by default, RCurl and jsonlite only, no C code
+#   2. with a C library build: the package with the native backend (native copied to src, HAVE_PRESTOCLIENT set)
+#
+# Usage: sh check.sh [builddir of the C library]
+# Needs R with packages RCurl and jsonlite. Stops at the first check that fails.
+
+set -e
+
+PACKAGEDIR=$(cd "$(dirname "$0")" && pwd)
+WORKDIR=$(mktemp -d)
+trap 'rm -rf "$WORKDIR"' EXIT
+
+# 1. Default install
+echo "Checking RPresto without the native backend"
+mkdir "$WORKDIR/default"
+(cd "$WORKDIR/default" && R CMD build "$PACKAGEDIR" && R CMD check --no-manual RPresto_*.tar.gz)
+
+# 2. Native backend
+if [ -n "$1" ]
+then
+	LIBRARYDIR=$(cd "$1" && pwd)
+
+	echo "Checking RPresto with the native backend"
+	mkdir "$WORKDIR/native"
+	cp -r "$PACKAGEDIR" "$WORKDIR/native/RPresto"
+	cp -r "$PACKAGEDIR/native" "$WORKDIR/native/RPresto/src"
+
+	export PRESTOCLIENT_CPPFLAGS="-DHAVE_PRESTOCLIENT -I$PACKAGEDIR/../C/prestoclient"
+	export PRESTOCLIENT_LIBS="-L$LIBRARYDIR -lprestoclient -Wl,-rpath,$LIBRARYDIR"
+	(cd "$WORKDIR/native" && R CMD build RPresto && R CMD check --no-manual RPresto_*.tar.gz)
+fi
+
+echo "All checks passed"
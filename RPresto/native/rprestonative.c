@@ -0,0 +1,427 @@
+/*
+* Native backend of PrestoClient for R: runs queries with the C version of prestoclient and returns the data
+* as typed R vectors.
+*
+* Copyright 2013 Ivo Herweijer | easydatawarehousing.com
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at:
+*
+*    http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+// Not built by default, so RPresto installs without a C compiler. INSTALL describes how to copy this directory
+// to src. Only compiled in when HAVE_PRESTOCLIENT is defined, otherwise rpresto_available returns FALSE and
+// PrestoClient uses RCurl and jsonlite.
+//
+// prestoclient_query calls the callback functions below from inside curl. An R error must not jump out of
+// them, so all work with R objects is done through R_ToplevelExec, which catches errors and interrupts.
+// Inside it R_tryCatchError keeps the message of an error for the error of the query. It is available since R 3.4,
+// with older versions the query fails without the message.
+
+#include <R.h>
+#include <Rinternals.h>
+#include <R_ext/Rdynload.h>
+#include <Rversion.h>
+
+#ifdef HAVE_PRESTOCLIENT
+
+#include "prestoclient.h"
+
+// Error of a query that failed in R without a message: an interrupt, before R 3.4 also an error
+#if defined(R_VERSION) && R_VERSION >= R_Version(3, 4, 0)
+#define RPRESTO_FAILED_ERROR "Interrupted while converting the data or in the data callback function"
+#else
+#define RPRESTO_FAILED_ERROR "Error or interrupt while converting the data or in the data callback function"
+#endif
+
+/* --- Structs -------------------------------------------------------------------------------------------------------- */
+typedef struct ST_RPRESTOQUERY
+{
+	PRESTOCLIENT_BATCH			 *batch;						// Rows of the current response, per column
+	PRESTOCLIENT_RESULT			 *result;						// Result of the running query
+	SEXP						  callback;						// R function called with every page or R_NilValue
+	SEXP						  pages;						// List of pages when there is no callback, preserved
+	R_xlen_t					  pagecount;					// Number of pages in the list
+	SEXP						  names;						// Column names, preserved, R_NilValue until known
+	SEXP						  types;						// Column types as sent by the server, preserved
+	SEXP						  message;						// Message of the R error that failed the query, preserved
+	SEXP						(*function)(void*);				// Function run by run_function
+	int							  failed;						// True when converting a page or the callback failed
+} RPRESTOQUERY;
+
+/* --- Private functions ---------------------------------------------------------------------------------------------- */
+static void preserve(SEXP *target, SEXP value)
+{
+	R_PreserveObject(value);
+
+	if (*target != R_NilValue)
+		R_ReleaseObject(*target);
+
+	*target = value;
+}
+
+static void check_interrupt(void *unused)
+{
+	(void)unused;
+
+	R_CheckUserInterrupt();
+}
+
+static SEXP get_column(PRESTOCLIENT_BATCH *batch, unsigned int column, unsigned int rows)
+{
+	SEXP values;
+	const char *nulls = prestoclient_batch_getnullcount(batch, column) > 0 ? prestoclient_batch_getnulls(batch, column) : NULL;
+	void *data = prestoclient_batch_getvalues(batch, column);
+	unsigned int *offsets;
+	unsigned int i;
+
+	switch (prestoclient_batch_getcolumntype(batch, column) )
+	{
+		case PRESTOCLIENT_BATCH_BIGINT:
+			// R has no 64 bit integers, like the RCurl backend bigint becomes numeric
+			values = allocVector(REALSXP, rows);
+
+			for (i = 0; i < rows; i++)
+				REAL(values)[i] = nulls && nulls[i] ? NA_REAL : (double)((long long*)data)[i];
+
+			break;
+
+		case PRESTOCLIENT_BATCH_DOUBLE:
+			values = allocVector(REALSXP, rows);
+
+			for (i = 0; i < rows; i++)
+				REAL(values)[i] = nulls && nulls[i] ? NA_REAL : ((double*)data)[i];
+
+			break;
+
+		case PRESTOCLIENT_BATCH_BOOLEAN:
+			values = allocVector(LGLSXP, rows);
+
+			for (i = 0; i < rows; i++)
+				LOGICAL(values)[i] = nulls && nulls[i] ? NA_LOGICAL : ((char*)data)[i] != 0;
+
+			break;
+
+		default:
+			values  = PROTECT(allocVector(STRSXP, rows) );
+			offsets = prestoclient_batch_getoffsets(batch, column);
+
+			// Every value is followed by a zero byte, which is not part of the value
+			for (i = 0; i < rows; i++)
+			{
+				if (nulls && nulls[i])
+					SET_STRING_ELT(values, i, NA_STRING);
+				else
+					SET_STRING_ELT(values, i, mkCharLenCE( (char*)data + offsets[i], offsets[i + 1] - offsets[i] - 1, CE_UTF8) );
+			}
+
+			UNPROTECT(1);
+			break;
+	}
+
+	return values;
+}
+
+// Turns the rows in the batch into a page, a named list of column vectors, and passes it on. Run by run_r
+static SEXP send_page(void *in_query)
+{
+	RPRESTOQUERY *query = (RPRESTOQUERY*)in_query;
+	unsigned int rows, columns, i;
+	SEXP page, pages;
+	R_xlen_t size, j;
+
+	rows    = prestoclient_batch_getrowcount(query->batch);
+	columns = prestoclient_batch_getcolumncount(query->batch);
+
+	if (rows == 0)
+		return R_NilValue;
+
+	page = PROTECT(allocVector(VECSXP, columns) );
+
+	for (i = 0; i < columns; i++)
+		SET_VECTOR_ELT(page, i, get_column(query->batch, i, rows) );
+
+	if (query->names != R_NilValue)
+	{
+		setAttrib(page, R_NamesSymbol, query->names);
+		setAttrib(page, install("types"), query->types);
+	}
+
+	if (query->callback != R_NilValue)
+	{
+		eval(PROTECT(lang2(query->callback, page) ), R_GlobalEnv);
+		UNPROTECT(1);
+	}
+	else
+	{
+		// The list of pages grows by doubling
+		size = XLENGTH(query->pages);
+
+		if (query->pagecount == size)
+		{
+			pages = PROTECT(allocVector(VECSXP, size * 2) );
+
+			for (j = 0; j < size; j++)
+				SET_VECTOR_ELT(pages, j, VECTOR_ELT(query->pages, j) );
+
+			preserve(&query->pages, pages);
+			UNPROTECT(1);
+		}
+
+		SET_VECTOR_ELT(query->pages, query->pagecount++, page);
+	}
+
+	UNPROTECT(1);
+
+	return R_NilValue;
+}
+
+// Reads the column names and types of the query. Run by run_r
+static SEXP read_columns(void *in_query)
+{
+	RPRESTOQUERY *query = (RPRESTOQUERY*)in_query;
+	unsigned int columns, i;
+	SEXP names, types;
+
+	columns = prestoclient_getcolumncount(query->result);
+	names   = PROTECT(allocVector(STRSXP, columns) );
+	types   = PROTECT(allocVector(STRSXP, columns) );
+
+	for (i = 0; i < columns; i++)
+	{
+		SET_STRING_ELT(names, i, mkCharCE(prestoclient_getcolumnname(query->result, i), CE_UTF8) );
+		SET_STRING_ELT(types, i, mkCharCE(prestoclient_getcolumnservertype(query->result, i), CE_UTF8) );
+	}
+
+	preserve(&query->types, types);
+	preserve(&query->names, names);
+	UNPROTECT(2);
+
+	return R_NilValue;
+}
+
+// Keeps the message of an R error, a condition is a list that starts with the message
+static SEXP keep_error(SEXP condition, void *in_query)
+{
+	RPRESTOQUERY *query = (RPRESTOQUERY*)in_query;
+	SEXP message = isNewList(condition) && XLENGTH(condition) > 0 ? VECTOR_ELT(condition, 0) : R_NilValue;
+
+	query->failed = 1;
+
+	if (isString(message) && XLENGTH(message) > 0)
+	{
+		PROTECT(message = ScalarString(STRING_ELT(message, 0) ) );
+		preserve(&query->message, message);
+		UNPROTECT(1);
+	}
+
+	return R_NilValue;
+}
+
+// Run by R_ToplevelExec, an error in the function is handled by keep_error, an interrupt ends R_ToplevelExec
+static void run_function(void *in_query)
+{
+	RPRESTOQUERY *query = (RPRESTOQUERY*)in_query;
+
+#if defined(R_VERSION) && R_VERSION >= R_Version(3, 4, 0)
+	R_tryCatchError(query->function, query, &keep_error, query);
+#else
+	query->function(query);
+#endif
+}
+
+// Runs a function that works with R objects, returns false when it failed
+static int run_r(RPRESTOQUERY *query, SEXP (*function)(void*) )
+{
+	query->function = function;
+
+	if (!R_ToplevelExec(&run_function, query) )
+		query->failed = 1;
+
+	return !query->failed;
+}
+
+static void write_callback(void *in_query, void *in_result)
+{
+	prestoclient_batch_writecallback( ( (RPRESTOQUERY*)in_query)->batch, in_result);
+}
+
+static void describe_callback(void *in_query, void *in_result)
+{
+	RPRESTOQUERY *query = (RPRESTOQUERY*)in_query;
+
+	query->result = (PRESTOCLIENT_RESULT*)in_result;
+
+	if (!run_r(query, &read_columns) )
+		prestoclient_cancelquery(query->result);
+}
+
+// Called after every response: hands the rows of the response to R, a pending interrupt cancels the query
+static void progress_callback(void *in_query, void *in_result)
+{
+	RPRESTOQUERY *query = (RPRESTOQUERY*)in_query;
+
+	query->result = (PRESTOCLIENT_RESULT*)in_result;
+
+	if (!query->failed)
+		run_r(query, &send_page);
+
+	prestoclient_batch_clear(query->batch);
+
+	if (query->failed || !R_ToplevelExec(&check_interrupt, NULL) )
+		prestoclient_cancelquery(query->result);
+}
+
+static SEXP make_string(const char *value)
+{
+	return mkString(value ? value : "");
+}
+
+/* --- Public functions ----------------------------------------------------------------------------------------------- */
+SEXP rpresto_available()
+{
+	return ScalarLogical(TRUE);
+}
+
+SEXP rpresto_query(SEXP inServer, SEXP inPort, SEXP inCatalog, SEXP inUser, SEXP inSql, SEXP inSchema, SEXP inCallback)
+{
+	static const char *fields[] = { "status", "state", "error", "message", "names", "types", "pages", "" };
+	RPRESTOQUERY query;
+	PRESTOCLIENT *client;
+	PRESTOCLIENT_RESULT *result;
+	unsigned int port = (unsigned int)asInteger(inPort);
+	const char *error = NULL, *message = NULL;
+	SEXP answer, pages;
+	R_xlen_t i;
+
+	query.batch     = NULL;
+	query.result    = NULL;
+	query.callback  = isFunction(inCallback) ? inCallback : R_NilValue;
+	query.pages     = R_NilValue;
+	query.pagecount = 0;
+	query.names     = R_NilValue;
+	query.types     = R_NilValue;
+	query.message   = R_NilValue;
+	query.function  = NULL;
+	query.failed    = 0;
+
+	client = prestoclient_init(CHAR(asChar(inServer) ), &port, CHAR(asChar(inCatalog) ), CHAR(asChar(inUser) ), NULL, NULL, NULL);
+
+	if (!client)
+		return R_NilValue;
+
+	preserve(&query.pages, PROTECT(allocVector(VECSXP, 16) ) );
+	preserve(&query.types, PROTECT(allocVector(STRSXP, 0) ) );
+	UNPROTECT(2);
+	query.batch = prestoclient_batch_new();
+
+	prestoclient_setprogresscallback(client, &progress_callback);
+
+	result = prestoclient_query(client, CHAR(asChar(inSql) ), CHAR(asChar(inSchema) ), &write_callback, &describe_callback, &query);
+
+	// Rows received after the last response was handled, when the query was cancelled
+	if (result)
+	{
+		query.result = result;
+
+		if (!query.failed)
+			run_r(&query, &send_page);
+	}
+
+	answer = PROTECT(mkNamed(VECSXP, fields) );
+
+	if (result)
+	{
+		SET_VECTOR_ELT(answer, 0, ScalarInteger( (int)prestoclient_getstatus(result) ) );
+		SET_VECTOR_ELT(answer, 1, make_string(prestoclient_getlastserverstate(result) ) );
+
+		// Without the exception type, like the error of the RCurl backend. Json escape sequences are translated in R
+		message = prestoclient_getlastservermessage(result);
+		error   = prestoclient_getlastservererror(result);
+
+		if (!error || !*error)
+			error = prestoclient_getlastclienterror(result);
+
+		if (!error || !*error)
+			error = prestoclient_getlastcurlerror(result);
+	}
+	else
+	{
+		SET_VECTOR_ELT(answer, 0, ScalarInteger(PRESTOCLIENT_STATUS_FAILED) );
+		SET_VECTOR_ELT(answer, 1, make_string("") );
+		error = "Could not start the query";
+	}
+
+	// The message of the R error, an interrupt has none
+	if (query.failed)
+	{
+		message = NULL;
+		error   = query.message != R_NilValue ? CHAR(STRING_ELT(query.message, 0) ) : RPRESTO_FAILED_ERROR;
+	}
+
+	SET_VECTOR_ELT(answer, 2, make_string(error) );
+	SET_VECTOR_ELT(answer, 3, make_string(message) );
+	SET_VECTOR_ELT(answer, 4, query.names != R_NilValue ? query.names : allocVector(STRSXP, 0) );
+	SET_VECTOR_ELT(answer, 5, query.types);
+
+	pages = allocVector(VECSXP, query.pagecount);
+	SET_VECTOR_ELT(answer, 6, pages);
+
+	for (i = 0; i < query.pagecount; i++)
+		SET_VECTOR_ELT(pages, i, VECTOR_ELT(query.pages, i) );
+
+	// The answer refers to these now, it is protected
+	R_ReleaseObject(query.pages);
+	R_ReleaseObject(query.types);
+
+	if (query.names != R_NilValue)
+		R_ReleaseObject(query.names);
+
+	if (query.message != R_NilValue)
+		R_ReleaseObject(query.message);
+
+	prestoclient_batch_delete(query.batch);
+	prestoclient_close(client);
+
+	UNPROTECT(1);
+
+	return answer;
+}
+
+#else
+
+SEXP rpresto_available()
+{
+	return ScalarLogical(FALSE);
+}
+
+SEXP rpresto_query(SEXP inServer, SEXP inPort, SEXP inCatalog, SEXP inUser, SEXP inSql, SEXP inSchema, SEXP inCallback)
+{
+	error("RPresto was installed without the C version of prestoclient, see INSTALL");
+
+	return R_NilValue;
+}
+
+#endif // HAVE_PRESTOCLIENT
+
+/* --- Registration --------------------------------------------------------------------------------------------------- */
+static const R_CallMethodDef callmethods[] =
+{
+	{ "rpresto_available",	(DL_FUNC)&rpresto_available,	0 },
+	{ "rpresto_query",		(DL_FUNC)&rpresto_query,		7 },
+	{ NULL, NULL, 0 }
+};
+
+void R_init_RPresto(DllInfo *dll)
+{
+	R_registerRoutines(dll, NULL, callmethods, NULL, NULL);
+	R_useDynamicSymbols(dll, FALSE);
+}
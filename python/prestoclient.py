@@ -20,9 +20,19 @@
 
 import httplib
 import socket
-import urllib2
+import errno
+import urlparse
 import json
+import re
+import zlib
 import getpass
+import os
+import threading
+import Queue
+import ctypes
+import ctypes.util
+from itertools import izip
+from collections import OrderedDict, deque
 from time import sleep
 
 
@@ -56,6 +66,39 @@ class PrestoClient:
     >>>     print "Columns: ", presto.getcolumns()
     >>>     if presto.getdata(): print "Datalength: ", presto.getnumberofdatarows(), " Data: ", presto.getdata()
 
+    runquery() keeps all data in memory until the query has finished. To handle large results use iterrows()
+    or iterpages(), which return the data as soon as it arrives and don't keep it afterwards:
+
+    >>> if presto.startquery(sql):
+    >>>     for row in presto.iterrows():
+    >>>         print row
+    >>>
+    >>>     if presto.getstatus() != "SUCCEEDED":
+    >>>         print "Error: ", presto.getlasterrormessage()
+
+    getnumpy() and getdataframe() return the data of a query as typed numpy arrays or a pandas DataFrame, filled
+    page by page without building a list of rows first:
+
+    >>> if presto.startquery(sql):
+    >>>     frame = presto.getdataframe()
+
+    PrestoClientPool runs many queries at the same time, each in its own PrestoClient, on a limited number of
+    threads that share their connections to the Presto server:
+
+    >>> pool = prestoclient.PrestoClientPool("localhost", in_maximumqueries=8)
+    >>> queries = [pool.submit(sql) for sql in statements]
+    >>>
+    >>> for query in queries:
+    >>>     if query.getstatus() == "SUCCEEDED": print query.getdata()
+    >>>
+    >>> pool.close()
+
+    With in_native=True PrestoClient uses the C version of prestoclient (libprestoclient) for the http requests and
+    json parsing, when the library can be found. Set environment variable PRESTOCLIENT_LIBRARY to the path of the
+    library if it is not installed. Without the library the pure Python implementation is used, see isnative().
+    getcolumns() then returns the name and type of every column as sent by the server, but not the typeSignature
+    that newer servers add.
+
     Presto client protocol
     ======================
 
@@ -92,9 +135,6 @@ class PrestoClient:
     Todo
     ====
 
-        - Enable PrestoClient to handle multiple running queries simultaneously. Currently you can only run
-        one query per instance of this class.
-
         - Add support for https connections
 
         - Add support for insert/update queries (if and when Presto server supports this).
@@ -112,9 +152,11 @@ class PrestoClient:
     __version = "0.3.1"                         #: PrestoClient version string
     __useragent = __source + "/" + __version    #: Useragent name sent to Presto server
     __urltimeout = 5000                         #: Timeout in millisec to wait for Presto server to respond
-    __updatewaittimemsec = 1500                 #: Wait time in millisec to wait between requests to Presto server
-    __retrievewaittimemsec = 50                 #: Wait time in millisec to wait between requests when recieving data
-    __retrywaittimemsec = 100                   #: Wait time in millisec to wait before retrying a request
+    __updatewaittimemsec = 1500                 #: Longest wait time in millisec between requests to Presto server
+    __retrievewaittimemsec = 50                 #: Shortest wait time in millisec between requests without data
+    __retrywaittimemsec = 100                   #: Wait time in millisec before the first retry, doubled for every retry
+    __maximumretrywaittimemsec = 5000           #: Longest wait time in millisec before retrying a request
+    __readsize = 65536                          #: Number of bytes read at a time from a response
     __maximumretries = 5                        #: Maximum number of retries fro request in case of 503 errors
     __server = ""                               #: IP address or DNS name of Presto server
     __port = 0                                  #: TCP port of Presto server
@@ -128,12 +170,24 @@ class PrestoClient:
     __lastcanceluri = ""                        #: Uri to cancel query on the Presto server
     __laststate = ""                            #: State returned by last request to Presto server
     __clientstatus = "NONE"                     #: Status defined by PrestoClient: NONE, RUNNING, SUCCEEDED, FAILED
+    __waittimemsec = 0                          #: Wait time in millisec before the next request, see __wait
+    __waitstate = ""                            #: Query state at the previous wait
+    __pagereceived = False                      #: Boolean, True when the last response contained data
+    __running = False                           #: Boolean, True when the last response had a link to the next one
     __cancelquery = False                       #: Boolean, when set to True signals that query should be cancelled
     __lastresponse = {}                         #: Buffer for last response of Presto server
     __columns = {}                              #: Buffer for the column information returned by the query
     __data = []                                 #: Buffer for the data returned by the query
-
-    def __init__(self, in_server, in_port=8080, in_catalog="hive", in_user="", in_timezone="", in_language=""):
+    __pagedata = []                             #: Data returned by the last request to Presto server
+    __streaming = False                         #: Boolean, when True data is returned by iterpages and not buffered
+    __connectionpool = None                     #: Persistent http connections, may be shared by several clients
+    __ownconnectionpool = False                 #: Boolean, True when the connection pool is closed by this client
+    __compression = False                       #: Boolean, True to ask for gzip or deflate compressed responses
+    __native = None                             #: C library used for queries, None to use Python only
+    __nativequery = None                        #: Query running in the C library
+
+    def __init__(self, in_server, in_port=8080, in_catalog="hive", in_user="", in_timezone="", in_language="",
+                 in_native=False, in_connectionpool=None, in_compression=False):
         """ Constructor of PrestoClient class.
 
         Arguments:
@@ -153,9 +207,18 @@ class PrestoClient:
         in_language -- Language to pass to the Prestoserver. Leave blank (=default) for the servers default language.
         (ISO-639-1 code)
 
+        in_native   -- If True run queries with the C library when it can be loaded (default False)
+
+        in_connectionpool -- PrestoConnectionPool to share connections with other clients. If None the client
+        has its own connections (default None)
+
+        in_compression -- If True ask the Presto server to compress its responses with gzip or deflate. Saves
+        bandwidth at the cost of some cpu time, not used by the C library (default False)
+
         """
         self.__server = in_server
         self.__port = in_port
+        self.__compression = in_compression
         self.__catalog = in_catalog
         self.__timezone = in_timezone
         self.__language = in_language
@@ -165,11 +228,27 @@ class PrestoClient:
         else:
             self.__user = in_user
 
+        if in_connectionpool is None:
+            self.__connectionpool = PrestoConnectionPool()
+            self.__ownconnectionpool = True
+        else:
+            self.__connectionpool = in_connectionpool
+
+        # Buffers are created per instance, so clients in different threads never share them
+        self.__lastresponse = {}
+        self.__columns = {}
+        self.__data = []
+        self.__pagedata = []
+
+        if in_native:
+            self.__native = _loadnativelibrary()
+
         return
 
     def runquery(self, in_sql_statement, in_schema="default"):
-        """ Execute a query. Currently, only one simultaneous query per instance of the PrestoClient class is allowed.
-        Starting a new query will discard any data previously retrieved ! Returns True if query succeeded.
+        """ Execute a query. Only one simultaneous query per instance of the PrestoClient class is allowed, use
+        PrestoClientPool to run several queries at the same time. Starting a new query will discard any data
+        previously retrieved ! Returns True if query succeeded.
 
         Arguments:
 
@@ -186,6 +265,20 @@ class PrestoClient:
 
         return self.__clientstatus == "SUCCEEDED"
 
+    def close(self):
+        """ Close the connections to the Presto server. A new connection is opened by the next request. A shared
+        connection pool is left open, it is closed by its owner.
+
+        """
+        if self.__ownconnectionpool:
+            self.__connectionpool.close()
+
+        return
+
+    def isnative(self):
+        """ Return True if queries are run with the C library. """
+        return self.__native is not None
+
     def getversion(self):
         """ Return PrestoClient version number. """
         return self.__version
@@ -207,7 +300,10 @@ class PrestoClient:
         return self.__lasterror
 
     def getcolumns(self):
-        """ Return the column information of the queryresults. Nested list of datatype / fieldname. """
+        """ Return the column information of the queryresults. Nested list of datatype / fieldname. With the C
+        library the typeSignature is not included.
+
+        """
         return self.__columns
 
     def getnumberofdatarows(self):
@@ -220,12 +316,108 @@ class PrestoClient:
 
     def cleardata(self):
         """ Empty the data buffer. You can use this function to implement your own 'streaming' data retrieval setup. """
-        self.__data = {}
+        self.__data = []
         return
 
+    def iterpages(self):
+        """ Generator returning the data of the running query one page at a time, a list of rows for every part of
+        a response of the Presto server that contains data. Call startquery() first. Data is returned as soon
+        as it is received and decoded, also while the rest of the response is still on its way, and is not added
+        to the data buffer, so memory use is limited to one page. Data that was buffered before is returned
+        first. Check getstatus() when the generator is exhausted.
+
+        """
+        self.__streaming = True
+
+        try:
+            if self.__data:
+                page = self.__data
+                self.__data = []
+                self.__pagedata = []
+                yield page
+
+            while True:
+                if self.__nativequery:
+                    running = self.queryisrunning()
+                else:
+                    for page in self.__nextresponse(True):
+                        yield page
+
+                    running = self.__running
+
+                if self.__pagedata:
+                    page = self.__pagedata
+                    self.__pagedata = []
+                    yield page
+
+                if not running:
+                    break
+
+                self.__wait()
+
+        finally:
+            self.__streaming = False
+
+        return
+
+    def iterrows(self):
+        """ Generator returning the data of the running query row by row. See iterpages(). """
+        for page in self.iterpages():
+            for row in page:
+                yield row
+
+        return
+
+    def getnumpy(self):
+        """ Wait until the query has finished and return the data as numpy arrays: a dictionary, ordered like
+        getcolumns(), of column name and masked array. Columns of type bigint, double, boolean, date and timestamp
+        become int64, float64, bool, datetime64[D] and datetime64[ms] arrays, all other columns object arrays.
+        Null values are masked. The arrays are filled page by page, the data is not kept as a list of rows.
+        Call startquery() first. Requires numpy.
+
+        """
+        import numpy
+
+        # The C library can hand over typed columns directly
+        if self.__nativequery:
+            self.__nativequery.setnumpy(numpy)
+
+        columns = None
+
+        for page in self.iterpages():
+            if columns is None:
+                columns = [_NumpyColumn(numpy, column["type"]) for column in self.__columns]
+
+            if not isinstance(page, tuple):
+                page = _numpypage(numpy, page, len(columns))
+
+            for column, (values, nulls) in izip(columns, page):
+                column.add(values, nulls)
+
+        if columns is None:
+            columns = [_NumpyColumn(numpy, column["type"]) for column in self.__columns]
+
+        return OrderedDict((info["name"], column.getarray()) for info, column in izip(self.__columns, columns))
+
+    def getdataframe(self):
+        """ Wait until the query has finished and return the data as a pandas DataFrame, made from the arrays
+        returned by getnumpy(). Null values become NaN, NaT or None. Bigint and boolean columns with null values use
+        the nullable Int64 and boolean types when pandas has them, otherwise float64 and object.
+        Call startquery() first. Requires pandas.
+
+        """
+        import numpy
+        import pandas
+
+        arrays = self.getnumpy()
+
+        return pandas.DataFrame(OrderedDict((name, _pandascolumn(pandas, numpy, array))
+                                            for name, array in arrays.items()), columns=list(arrays.keys()))
+
     def startquery(self, in_sql_statement, in_schema="default"):
-        """ Start a query. Currently, only one simultaneous query per instance of the PrestoClient class is allowed.
-        Starting a new query will discard any data previously retrieved !
+        """ Start a query. Only one simultaneous query per instance of the PrestoClient class is allowed, use
+        PrestoClientPool to run several queries at the same time. Starting a new query will discard any data
+        previously retrieved !
 
         Arguments:
 
@@ -271,22 +463,31 @@ class PrestoClient:
         self.__lastresponse = {}
         self.__columns = {}
         self.__data = []
+        self.__pagedata = []
+        self.__nativequery = None
+        self.__waittimemsec = 0
+        self.__waitstate = ""
+        self.__pagereceived = False
+
+        if self.__native:
+            return self.__startnativequery(sql, in_schema)
 
         try:
-            conn = httplib.HTTPConnection(self.__server, self.__port, False, self.__urltimeout)
-            conn.request("POST", "/v1/statement", sql, headers)
-            response = conn.getresponse()
+            retrycount = 0
 
-            # Todo: add check on 503 return codes. In that case retry request. See __openuri
+            while True:
+                status, reason, answer = self.__request("POST", "/v1/statement", sql, headers)
 
-            if response.status != 200:
-                self.__lasterror = "Connection error: " + str(response.status) + " " + response.reason
-                conn.close()
-                return False
+                # A busy server has not accepted the query, so it can be sent again
+                if status != 503 or retrycount >= self.__maximumretries:
+                    break
 
-            answer = response.read()
+                retrycount += 1
+                self.__backoff(retrycount)
 
-            conn.close()
+            if status != 200:
+                self.__lasterror = "Connection error: " + str(status) + " " + reason
+                return False
 
             self.__lastresponse = json.loads(answer)
             self.__getvarsfromresponse()
@@ -316,10 +517,7 @@ class PrestoClient:
                 tries += 1
                 print "Ping: ", tries, " Rows=", len(self.__data)
 
-            if self.__data:
-                sleep(self.__retrievewaittimemsec/1000)
-            else:
-                sleep(self.__updatewaittimemsec/1000)
+            self.__wait()
 
         if in_verbose:
             print "Done: ", tries + 1, " Rows=", len(self.__data)
@@ -328,25 +526,13 @@ class PrestoClient:
 
     def queryisrunning(self):
         """ Returns True if query is running. """
-        if self.__cancelquery:
-            self.__cancel()
-            return False
+        if self.__nativequery:
+            return self.__nativequeryisrunning()
 
-        if self.__lastnexturi == "":
-            # This should never happen !
-            return False
-
-        if not self.__openuri(self.__lastnexturi):
-            return False
-
-        #print "response: ", self.__lastresponse
-
-        self.__getvarsfromresponse()
-
-        if self.__lastnexturi == "":
-            return False
+        for page in self.__nextresponse(False):
+            pass
 
-        return True
+        return self.__running
 
     def getqueryinfo(self):
         """ Requests query information from the Presto server and returns this as a dictonary. The Presto
@@ -367,10 +553,137 @@ class PrestoClient:
 
         """
         self.__cancelquery = True
+
+        # The C library stops a running request at once, also when called from another thread
+        if self.__nativequery:
+            self.__nativequery.cancel()
+
+        return
+
+    def __nextresponse(self, in_streamrows):
+        """ Internal generator, requests the next response of the running query. With in_streamrows=True the rows
+        are yielded while the response is decoded, otherwise they are buffered. Afterwards __running is True if
+        the query has more responses.
+
+        """
+        self.__running = False
+
+        if self.__cancelquery:
+            self.__cancel()
+            return
+
+        if self.__lastnexturi == "":
+            # This should never happen !
+            return
+
+        for page in self.__openuripages(self.__lastnexturi, in_streamrows):
+            yield page
+
+        if self.__lasterror:
+            return
+
+        #print "response: ", self.__lastresponse
+
+        self.__getvarsfromresponse()
+
+        self.__running = self.__lastnexturi != ""
+
+    def __wait(self):
+        """ Internal function, waits before the next request to the Presto server. While data is flowing the next
+        request is sent at once, the server holds a request until it has data or some time has passed. Otherwise
+        the wait starts short when the query changed state (as reported in stats.state) and doubles up to
+        __updatewaittimemsec while the state stays the same. The C library waits by itself.
+
+        """
+        if self.__nativequery:
+            return
+
+        if self.__pagereceived or self.__laststate in ("FINISHED", "FAILED"):
+            self.__waittimemsec = 0
+        elif self.__laststate != self.__waitstate or self.__waittimemsec == 0:
+            self.__waittimemsec = self.__retrievewaittimemsec
+        else:
+            self.__waittimemsec = min(self.__waittimemsec * 2, self.__updatewaittimemsec)
+
+        self.__waitstate = self.__laststate
+
+        if self.__waittimemsec > 0:
+            sleep(self.__waittimemsec / 1000.0)
+
+        return
+
+    def __backoff(self, in_retrycount):
+        """ Internal function, waits before retrying a request the server answered with 503 (busy). The wait time
+        doubles with every retry.
+
+        """
+        sleep(min(self.__retrywaittimemsec * 2 ** (in_retrycount - 1), self.__maximumretrywaittimemsec) / 1000.0)
+        return
+
+    def __startnativequery(self, in_sql_statement, in_schema):
+        """ Internal function, starts a query with the C library. """
+        self.__nativequery = _NativeQuery(self.__native, self.__server, self.__port, self.__catalog, self.__user,
+                                          self.__timezone, self.__language, in_sql_statement, in_schema)
+
+        started = self.__nativequery.start()
+        self.__getvarsfromnative(None)
+
+        return started
+
+    def __nativequeryisrunning(self):
+        """ Internal function, returns True if the query running in the C library has more data. """
+        if self.__cancelquery:
+            self.__nativequery.cancel()
+
+            # Discard data still on its way, so the query thread can finish
+            while self.__nativequery.nextpage() is not None:
+                pass
+
+            self.__getvarsfromnative(None)
+            return False
+
+        page = self.__nativequery.nextpage()
+        self.__getvarsfromnative(page)
+
+        return page is not None
+
+    def __getvarsfromnative(self, in_page):
+        """ Internal function, same as __getvarsfromresponse for a query running in the C library. """
+        self.__laststate = self.__nativequery.state
+        self.__lasterror = self.__nativequery.error
+
+        if not self.__columns:
+            self.__columns = self.__nativequery.columns
+
+        if in_page is not None:
+            self.__pagedata = in_page
+
+            if not self.__streaming:
+                if self.__data:
+                    self.__data.extend(in_page)
+                else:
+                    self.__data = in_page
+        else:
+            self.__pagedata = []
+
+        self.__clientstatus = self.__nativequery.status
+
         return
 
     def __openuri(self, in_uri):
         """ Internal function, sends a GET request to the Presto server """
+        for page in self.__openuripages(in_uri, False):
+            pass
+
+        return self.__lasterror == ""
+
+    def __openuripages(self, in_uri, in_streamrows):
+        """ Internal generator, sends a GET request to the Presto server. With in_streamrows=True the response is
+        decoded while it arrives, so the raw response is never kept complete next to the decoded one, and the
+        rows of the 'data' member are yielded as soon as they are decoded instead of being kept in
+        __lastresponse. On failure __lasterror is set.
+
+        """
         headers = {"X-Presto-Source":  self.__source,
                    "User-Agent":       self.__useragent,
                    "X-Presto-User":    self.__user}
@@ -378,37 +691,154 @@ class PrestoClient:
         self.__lasterror = ""
 
         try:
-            retry = True
             retrycount = 0
 
-            while retry:
-                retrycount += 1
-                conn = urllib2.urlopen(in_uri, None, self.__urltimeout)
-                answer = conn.read()
-                conn.close()
-                self.__lastresponse = json.loads(answer)
+            while True:
+                address, connection, response = self.__sendrequest("GET", in_uri, None, headers)
 
-                if retrycount > self.__maximumretries:
-                    self.__lasterror = "Maximum number of retries reached"
-                    return False
+                if response.status != 200:
+                    self.__readresponse(address, connection, response)
 
-                if conn.getcode() == 503:
-                    sleep(self.__retrywaittimemsec/1000)
-                else:
-                    retry = False
+                    if response.status != 503:
+                        self.__lasterror = "HTTP error: " + str(response.status) + " " + response.reason
+                        return
 
-        except urllib2.HTTPError as e:
-            self.__lasterror = "HTTP error: " + e.reason
-            return False
+                    if retrycount >= self.__maximumretries:
+                        self.__lasterror = "Maximum number of retries reached"
+                        return
 
-        except urllib2.URLError as e:
-            self.__lasterror = "URL error: " + e.reason
-            return False
+                    retrycount += 1
+                    self.__backoff(retrycount)
+                    continue
+
+                # When the rows are buffered anyway decoding the response at once is faster
+                if not in_streamrows:
+                    answer = self.__readresponse(address, connection, response)
+                    self.__lastresponse = json.loads(answer)
+                    return
+
+                decoder = _ResponseDecoder()
+                decompressor = _Decompressor.get(response)
+                complete = False
+
+                # A connection is only reused when the response was read completely
+                try:
+                    while not complete:
+                        chunk = response.read(self.__readsize)
+                        complete = chunk == ""
+
+                        if decompressor:
+                            chunk = decompressor.flush() if complete else decompressor.decompress(chunk)
+
+                        page = decoder.feed(chunk, complete)
+
+                        if page:
+                            yield page
+                finally:
+                    if complete:
+                        self.__connectionpool.putconnection(address, connection)
+                    else:
+                        connection.close()
+
+                # The rows have been returned already
+                self.__lastresponse = decoder.response
+
+                if decoder.hasdata:
+                    self.__lastresponse["data"] = []
+
+                return
+
+        except (httplib.HTTPException, socket.error) as e:
+            self.__lasterror = "Error connecting to server: " + str(e)
+
+        except ValueError as e:
+            self.__lasterror = "Invalid response from server: " + str(e)
+
+    def __request(self, in_method, in_uri, in_body, in_headers):
+        """ Internal function, sends a request to the Presto server and returns the http status, reason and body
+        of the response. Requests to the same server name and port reuse the idle connections of the connection
+        pool, as long as the server keeps them open. The uri's returned by the server usually name the server
+        differently than the client did, so there are two connections per server. When the server has closed a
+        connection that was idle, the request is sent once more on a new connection.
+
+        """
+        address, connection, response = self.__sendrequest(in_method, in_uri, in_body, in_headers)
+        answer = self.__readresponse(address, connection, response)
+
+        return response.status, response.reason, answer
+
+    def __readresponse(self, in_address, in_connection, in_response):
+        """ Internal function, reads the complete response, decompressed, and returns the connection to the pool. """
+        try:
+            answer = in_response.read()
+        except (httplib.HTTPException, socket.error):
+            in_connection.close()
+            raise
+
+        decompressor = _Decompressor.get(in_response)
+
+        if decompressor:
+            answer = decompressor.decompress(answer) + decompressor.flush()
+
+        self.__connectionpool.putconnection(in_address, in_connection)
+
+        return answer
+
+    def __sendrequest(self, in_method, in_uri, in_body, in_headers):
+        """ Internal function, sends a request to the Presto server and returns the server name and port, the
+        connection and the response, of which only the headers have been read. Return the connection to the
+        pool after reading the response, see __request.
+
+        """
+        url = urlparse.urlsplit(in_uri)
 
+        if url.netloc:
+            address = (url.hostname, url.port or 80)
+            path = url.path + ("?" + url.query if url.query else "")
         else:
-            pass
+            address = (self.__server, self.__port)
+            path = in_uri
 
-        return True
+        if self.__compression:
+            in_headers = dict(in_headers)
+            in_headers["Accept-Encoding"] = "gzip, deflate"
+
+        reuse = True
+
+        while True:
+            connection, reused = self.__connectionpool.getconnection(address, self.__urltimeout, reuse)
+
+            # A request on a connection that was used before is sent once more only when the server closed the idle
+            # connection: sending failed, or the connection was closed or reset without any answer. After a timeout
+            # or any other error the server may have received the request, a POST would start the query twice
+            try:
+                connection.request(in_method, path, in_body, in_headers)
+                response = connection.getresponse()
+
+            except (httplib.HTTPException, socket.error) as e:
+                connection.close()
+
+                if not reused or not self.__isclosedbyserver(e):
+                    raise
+
+                reuse = False
+
+            else:
+                return address, connection, response
+
+    @staticmethod
+    def __isclosedbyserver(in_error):
+        """ Internal function, returns True if a request failed because the server had closed the connection. """
+        if isinstance(in_error, socket.timeout):
+            return False
+
+        if isinstance(in_error, httplib.BadStatusLine):
+            # Connection closed before the status line: older versions of httplib report the empty line, newer
+            # versions a message that the server has closed the connection
+            return in_error.line in ("", "''") or "closed the connection" in in_error.line
+
+        return isinstance(in_error, socket.error) and in_error.errno in (errno.ECONNRESET, errno.EPIPE,
+                                                                        errno.ECONNABORTED)
 
     def __getvarsfromresponse(self):
         """ Internal function, retrieves some information from the response of the Presto server. Keep
@@ -436,11 +866,19 @@ class PrestoClient:
             if "columns" in self.__lastresponse:
                 self.__columns = self.__lastresponse["columns"]
 
+        self.__pagereceived = "data" in self.__lastresponse
+
         if "data" in self.__lastresponse:
-            if self.__data:
-                self.__data.extend(self.__lastresponse["data"])
-            else:
-                self.__data = self.__lastresponse["data"]
+            self.__pagedata = self.__lastresponse["data"]
+
+            # When streaming iterpages returns the data, otherwise add it to the data buffer
+            if not self.__streaming:
+                if self.__data:
+                    self.__data.extend(self.__lastresponse["data"])
+                else:
+                    self.__data = self.__lastresponse["data"]
+        else:
+            self.__pagedata = []
 
         # Determine state
         if self.__lastnexturi != "":
@@ -469,19 +907,14 @@ class PrestoClient:
         self.__lasterror = ""
 
         try:
-            conn = httplib.HTTPConnection(self.__server, self.__port, False, self.__urltimeout)
-            conn.request("DELETE", self.__lastcanceluri, None, headers)
-            response = conn.getresponse()
+            status, reason, answer = self.__request("DELETE", self.__lastcanceluri, None, headers)
 
-            if response.status != 204:
-                self.__lasterror = "Connection error: " + str(response.status) + " " + response.reason
-                conn.close()
+            if status != 204:
+                self.__lasterror = "Connection error: " + str(status) + " " + reason
                 return False
 
-            conn.close()
-
-        except httplib.HTTPException:
-            self.__lasterror = "Connection error: " + str(httplib.HTTPException.message)
+        except (httplib.HTTPException, socket.error) as e:
+            self.__lasterror = "Connection error: " + str(e)
             return False
 
         else:
@@ -490,3 +923,936 @@ class PrestoClient:
         self.__clientstatus = "NONE"
 
         return True
+
+
+class PrestoConnectionPool:
+    """ Idle http connections to Presto servers, by server name and port. Every PrestoClient has its own pool
+    unless one is passed to its constructor; a shared pool lets many clients, also in different threads, reuse
+    the same connections. A connection is used by one request at a time, it is returned to the pool when the
+    response has been read.
+
+    """
+
+    __maximumidle = 8                           #: Maximum number of idle connections kept per server name and port
+    __lock = None                               #: Lock protecting the dictionary of idle connections
+    __idle = None                               #: Lists of idle connections, by server name and port
+
+    def __init__(self, in_maximumidle=8):
+        """ Constructor of PrestoConnectionPool class.
+
+        Arguments:
+
+        in_maximumidle -- Maximum number of idle connections kept per server name and port, the connections of
+        a pool used by PrestoClientPool should be at least its maximum number of queries (default 8)
+
+        """
+        self.__maximumidle = in_maximumidle
+        self.__lock = threading.Lock()
+        self.__idle = {}
+
+    def getconnection(self, in_address, in_timeout, in_reuse=True):
+        """ Return a tuple of a connection to the server name and port in_address and True when the connection
+        was used before. A new connection is opened when there is no idle one or in_reuse is False. in_timeout is
+        the socket timeout of a new connection in millisec.
+
+        """
+        if in_reuse:
+            with self.__lock:
+                connections = self.__idle.get(in_address)
+
+                if connections:
+                    return connections.pop(), True
+
+        return httplib.HTTPConnection(in_address[0], in_address[1], False, in_timeout / 1000.0), False
+
+    def putconnection(self, in_address, in_connection):
+        """ Return a connection to the pool after its response has been read. """
+        with self.__lock:
+            connections = self.__idle.setdefault(in_address, [])
+
+            if len(connections) < self.__maximumidle:
+                connections.append(in_connection)
+                return
+
+        in_connection.close()
+
+    def close(self):
+        """ Close all idle connections. The pool can still be used afterwards. """
+        with self.__lock:
+            idle = self.__idle
+            self.__idle = {}
+
+        for connections in idle.values():
+            for connection in connections:
+                connection.close()
+
+
+class PrestoClientPool:
+    """ Runs many queries at the same time, at most in_maximumqueries at once. Every query gets its own
+    PrestoClient, all clients share one PrestoConnectionPool. submit() returns a PrestoQuery right away, the
+    query runs in one of the threads of the pool. Call close() when done to stop the threads.
+
+    """
+
+    __arguments = None                          #: Arguments for the PrestoClient of every query
+    __connectionpool = None                     #: Connections shared by all queries
+    __queue = None                              #: Queries waiting for a thread, None stops a thread
+    __threads = None                            #: Threads running the queries, started when needed
+    __maximumqueries = 8                        #: Maximum number of queries running at the same time
+    __idle = 0                                  #: Number of threads waiting for a query
+    __lock = None                               #: Lock protecting the queue, the list of threads and the idle count
+    __queued = None                             #: Condition on __lock, notified when a query is queued
+
+    def __init__(self, in_server, in_port=8080, in_catalog="hive", in_user="", in_timezone="", in_language="",
+                 in_native=False, in_maximumqueries=8, in_compression=False):
+        """ Constructor of PrestoClientPool class. The arguments are passed to every PrestoClient, see there.
+
+        Arguments:
+
+        in_maximumqueries -- Maximum number of queries running at the same time (default 8)
+
+        """
+        self.__connectionpool = PrestoConnectionPool(in_maximumqueries)
+        self.__arguments = (in_server, in_port, in_catalog, in_user, in_timezone, in_language, in_native,
+                            self.__connectionpool, in_compression)
+        self.__maximumqueries = in_maximumqueries
+        self.__queue = deque()
+        self.__threads = []
+        self.__lock = threading.Lock()
+        self.__queued = threading.Condition(self.__lock)
+
+    def submit(self, in_sql_statement, in_schema="default", in_streaming=False):
+        """ Queue a query and return its PrestoQuery. With in_streaming=True the data is not buffered but returned
+        by PrestoQuery.iterpages() and iterrows() while the query runs; the query then holds on to its thread
+        until all data has been read.
+
+        Arguments:
+
+        in_sql_statement -- The query that should be executed by the Presto server
+
+        in_schema        -- The HDFS schema that should be used (default 'default')
+
+        in_streaming     -- If True return the data page by page instead of buffering it (default False)
+
+        """
+        query = PrestoQuery(PrestoClient(*self.__arguments), in_sql_statement, in_schema, in_streaming)
+
+        with self.__lock:
+            self.__queue.append(query)
+
+            # A thread counts as idle until it has taken a query off the queue, both happen under the lock
+            if len(self.__threads) < self.__maximumqueries and len(self.__queue) > self.__idle:
+                thread = threading.Thread(target=self.__run)
+                thread.daemon = True
+                thread.start()
+                self.__threads.append(thread)
+
+            self.__queued.notify()
+
+        return query
+
+    def runqueries(self, in_sql_statements, in_schema="default"):
+        """ Run all queries of the list in_sql_statements and wait until they have finished. Returns the list of
+        their PrestoQuery's, in the same order.
+
+        """
+        queries = [self.submit(sql, in_schema) for sql in in_sql_statements]
+
+        for query in queries:
+            query.wait()
+
+        return queries
+
+    def close(self):
+        """ Wait until the submitted queries have finished, then stop the threads and close the connections. """
+        with self.__lock:
+            threads = self.__threads
+            self.__threads = []
+
+            for thread in threads:
+                self.__queue.append(None)
+
+            self.__queued.notify_all()
+
+        for thread in threads:
+            thread.join()
+
+        self.__connectionpool.close()
+
+    def __run(self):
+        """ Internal function, runs queries until it gets None from the queue. """
+        while True:
+            with self.__lock:
+                self.__idle += 1
+
+                while not self.__queue:
+                    self.__queued.wait()
+
+                query = self.__queue.popleft()
+                self.__idle -= 1
+
+            if query is None:
+                return
+
+            query.run()
+
+
+class PrestoQuery:
+    """ A query submitted to a PrestoClientPool. Its methods may be called from any thread; the methods that return
+    results wait until the query has finished.
+
+    """
+
+    __client = None                             #: PrestoClient running the query
+    __sql = ""                                  #: Statement of the query
+    __schema = ""                               #: Schema of the query
+    __streaming = False                         #: Boolean, True when the data is returned by iterpages
+    __pages = None                              #: Queue of pages for iterpages, None marks the end of the data
+    __finished = None                           #: Event, set when the query has finished
+    __cancelled = False                         #: Boolean, True when cancel() was called
+
+    __maximumpages = 2                          #: Number of pages that may wait in the queue when streaming
+
+    def __init__(self, in_client, in_sql_statement, in_schema, in_streaming):
+        self.__client = in_client
+        self.__sql = in_sql_statement
+        self.__schema = in_schema
+        self.__streaming = in_streaming
+        self.__pages = Queue.Queue(self.__maximumpages) if in_streaming else None
+        self.__finished = threading.Event()
+
+    def run(self):
+        """ Run the query in the current thread, called by PrestoClientPool. """
+        client = self.__client
+
+        try:
+            if self.__cancelled or not client.startquery(self.__sql, self.__schema):
+                return
+
+            # startquery clears a cancel request that came in while it was running
+            if self.__cancelled:
+                client.cancelquery()
+
+            if not self.__streaming:
+                client.waituntilfinished()
+            else:
+                for page in client.iterpages():
+                    self.__putpage(page)
+
+        finally:
+            client.close()
+            self.__finished.set()
+
+            if self.__pages:
+                self.__putpage(None)
+
+    def wait(self, in_timeout=None):
+        """ Wait until the query has finished or in_timeout seconds have passed. Returns True if it finished. """
+        # Without a timeout Event.wait can not be interrupted by KeyboardInterrupt
+        while in_timeout is None and not self.__finished.is_set():
+            self.__finished.wait(1.0)
+
+        return self.__finished.wait(in_timeout)
+
+    def isdone(self):
+        """ Returns True if the query has finished. """
+        return self.__finished.is_set()
+
+    def cancel(self):
+        """ Cancel the query. A query that has not started yet will not run, a running query stops after the
+        current request.
+
+        """
+        self.__cancelled = True
+        self.__client.cancelquery()
+
+    def getclient(self):
+        """ Returns the PrestoClient of the query, its methods should only be used after the query finished. """
+        return self.__client
+
+    def getstatus(self):
+        """ Wait until the query has finished and return its status, see PrestoClient.getstatus(). A query that
+        was cancelled before it started has status NONE.
+
+        """
+        self.wait()
+        return self.__client.getstatus()
+
+    def getlasterrormessage(self):
+        """ Wait until the query has finished and return its error message. """
+        self.wait()
+        return self.__client.getlasterrormessage()
+
+    def getcolumns(self):
+        """ Wait until the query has finished and return the column information. """
+        self.wait()
+        return self.__client.getcolumns()
+
+    def getdata(self):
+        """ Wait until the query has finished and return all data. Empty when the query was streaming. """
+        self.wait()
+        return self.__client.getdata()
+
+    def iterpages(self):
+        """ Generator returning the data of a streaming query page by page as soon as it has been received. Can
+        be used once. Call getstatus() afterwards to see if the query succeeded.
+
+        """
+        if not self.__streaming:
+            raise ValueError("Query was not submitted with in_streaming=True")
+
+        while True:
+            try:
+                page = self.__pages.get(True, 0.1)
+            except Queue.Empty:
+                # The end of the data is not queued when the query was cancelled
+                if self.__finished.is_set() and self.__pages.empty():
+                    return
+
+                continue
+
+            if page is None:
+                return
+
+            yield page
+
+    def iterrows(self):
+        """ Generator returning the rows of a streaming query one by one, see iterpages(). """
+        for page in self.iterpages():
+            for row in page:
+                yield row
+
+    def __putpage(self, in_page):
+        """ Internal function, queues a page for iterpages. Pages are dropped when the query was cancelled, nobody
+        may be reading them anymore.
+
+        """
+        while not self.__cancelled:
+            try:
+                self.__pages.put(in_page, True, 0.1)
+                return
+            except Queue.Full:
+                pass
+
+
+class _Decompressor:
+    """ Decompresses a gzip or deflate encoded response part by part. """
+
+    def __init__(self):
+        # Detects a gzip or zlib header by itself
+        self.__decompressor = zlib.decompressobj(32 + zlib.MAX_WBITS)
+        self.__started = False
+
+    @staticmethod
+    def get(in_response):
+        """ Returns a _Decompressor for the response if it is compressed, otherwise None. """
+        encoding = (in_response.getheader("Content-Encoding") or "").strip().lower()
+
+        if encoding in ("gzip", "x-gzip", "deflate"):
+            return _Decompressor()
+
+        return None
+
+    def decompress(self, in_data):
+        """ Returns the decompressed data of the next part of the response. """
+        try:
+            try:
+                data = self.__decompressor.decompress(in_data)
+            except zlib.error:
+                # Some servers send deflate data without the zlib header
+                if self.__started:
+                    raise
+
+                self.__decompressor = zlib.decompressobj(-zlib.MAX_WBITS)
+                data = self.__decompressor.decompress(in_data)
+
+        except zlib.error as e:
+            raise httplib.HTTPException("Invalid compressed response: " + str(e))
+
+        self.__started = self.__started or in_data != ""
+
+        return data
+
+    def flush(self):
+        """ Returns the decompressed data that is left at the end of the response. """
+        return self.__decompressor.flush()
+
+
+class _ResponseDecoder:
+    """ Decodes a json response of the Presto server part by part while it arrives. The rows of the 'data' member
+    are decoded one by one as soon as they are complete, all other members are decoded when they are complete.
+    Only the part of the response that could not be decoded yet is kept.
+
+    """
+
+    __whitespace = re.compile(r"[ \t\n\r]*")     #: Whitespace between json tokens
+    __rowseparator = re.compile(r"[ \t\n\r]*,?[ \t\n\r]*")  #: Separator between rows
+
+    def __init__(self):
+        self.response = {}                      #: Members of the response, except 'data'
+        self.hasdata = False                    #: Boolean, True when the response has a 'data' member
+        self.__decoder = json.JSONDecoder()
+        self.__buffer = ""
+        self.__state = "start"                  #: Next expected token: start, key, colon, value, row, member, end
+        self.__key = None
+
+    def feed(self, in_chunk, in_final):
+        """ Decode the next part of the response. Returns the list of rows of 'data' that were completed by it.
+        Set in_final when the response is complete. Raises ValueError when the response is no valid json.
+
+        """
+        buffer = self.__buffer + in_chunk if self.__buffer else in_chunk
+        position = 0
+        rows = []
+
+        while True:
+            position = self.__whitespace.match(buffer, position).end()
+
+            if position == len(buffer):
+                break
+
+            char = buffer[position]
+            state = self.__state
+
+            if state == "start":
+                if char != "{":
+                    raise ValueError("Expected an object at position " + str(position))
+
+                self.__state = "key"
+                position += 1
+
+            elif state in ("key", "member") and char == "}":
+                self.__state = "end"
+                position += 1
+
+            elif state == "member":
+                if char != ",":
+                    raise ValueError("Expected ',' or '}' at position " + str(position))
+
+                self.__state = "key"
+                position += 1
+
+            elif state == "key":
+                value, end = self.__decode(buffer, position, in_final)
+
+                if end is None:
+                    break
+
+                self.__key = value
+                self.__state = "colon"
+                position = end
+
+            elif state == "colon":
+                if char != ":":
+                    raise ValueError("Expected ':' at position " + str(position))
+
+                self.__state = "value"
+                position += 1
+
+            elif state == "value" and self.__key == "data" and char == "[":
+                # Rows of the data member are decoded one by one, other values at once
+                self.hasdata = True
+                self.__state = "row"
+                position += 1
+
+            elif state == "value":
+                value, end = self.__decode(buffer, position, in_final)
+
+                if end is None:
+                    break
+
+                self.response[self.__key] = value
+                self.__state = "member"
+                position = end
+
+            elif state == "row":
+                if char == "[":
+                    position = self.__decoderows(buffer, position, in_final, rows)
+
+                    if position == len(buffer) or buffer[position] == "[":
+                        break
+                elif char == "]":
+                    self.__state = "member"
+                    position += 1
+                elif char == ",":
+                    position += 1
+                else:
+                    value, end = self.__decode(buffer, position, in_final)
+
+                    if end is None:
+                        break
+
+                    rows.append(value)
+                    position = end
+
+            else:
+                raise ValueError("Unexpected data after the end of the response")
+
+        self.__buffer = buffer[position:]
+
+        if in_final and (self.__state != "end" or self.__buffer):
+            raise ValueError("Incomplete response")
+
+        return rows
+
+    def __decoderows(self, in_buffer, in_position, in_final, in_rows):
+        """ Decode rows, arrays separated by commas, and add them to in_rows. Returns the position after the last
+        complete row. This is where most of a response is decoded, so it calls the json scanner directly.
+
+        """
+        scan = self.__decoder.scan_once
+        separator = self.__rowseparator.match
+        length = len(in_buffer)
+        position = in_position
+
+        while position < length and in_buffer[position] == "[":
+            try:
+                value, end = scan(in_buffer, position)
+            except (StopIteration, ValueError):
+                if in_final:
+                    raise ValueError("Invalid row at position " + str(position))
+
+                break
+
+            if end == length and not in_final:
+                break
+
+            in_rows.append(value)
+            position = separator(in_buffer, end).end()
+
+        return position
+
+    def __decode(self, in_buffer, in_position, in_final):
+        """ Decode one json value. Returns the value and the position after it, or None for the position when the
+        value is not complete yet. A value at the very end of the buffer may continue in the next part.
+
+        """
+        try:
+            value, end = self.__decoder.raw_decode(in_buffer, in_position)
+        except ValueError:
+            if in_final:
+                raise
+
+            return None, None
+
+        if end == len(in_buffer) and not in_final:
+            return None, None
+
+        return value, end
+
+
+# Values of enums E_CLIENTSTATUS and E_BATCHTYPES in prestoclient.h
+_NATIVE_STATUS = ["NONE", "RUNNING", "SUCCEEDED", "FAILED"]
+_NATIVE_BATCH_TEXT, _NATIVE_BATCH_BIGINT, _NATIVE_BATCH_DOUBLE, _NATIVE_BATCH_BOOLEAN = range(4)
+
+_NATIVE_CALLBACK = ctypes.CFUNCTYPE(None, ctypes.c_void_p, ctypes.c_void_p)
+
+_nativelibrary = None           #: C library, loaded by the first PrestoClient that asks for it
+_nativelibraryloaded = False    #: True when loading the C library was tried
+
+
+def _loadnativelibrary():
+    """ Load the C library of prestoclient and declare the functions used. Returns None when the library is not
+    available or is too old.
+
+    """
+    global _nativelibrary, _nativelibraryloaded
+
+    if _nativelibraryloaded:
+        return _nativelibrary
+
+    _nativelibraryloaded = True
+
+    names = [os.environ.get("PRESTOCLIENT_LIBRARY"), ctypes.util.find_library("prestoclient"),
+             "libprestoclient.so", "libprestoclient.dylib", "prestoclient.dll"]
+
+    for name in names:
+        if not name:
+            continue
+
+        try:
+            library = ctypes.CDLL(name)
+            library.prestoclient_batch_new
+            library.prestoclient_getcolumnservertype
+        except (OSError, AttributeError):
+            continue
+
+        void_p, char_p, uint = ctypes.c_void_p, ctypes.c_char_p, ctypes.c_uint
+
+        for function, restype, argtypes in [
+                ("prestoclient_init",                     void_p, [char_p, ctypes.POINTER(uint), char_p, char_p,
+                                                                   char_p, char_p, char_p]),
+                ("prestoclient_close",                    None,   [void_p]),
+                ("prestoclient_setprogresscallback",      None,   [void_p, _NATIVE_CALLBACK]),
+                ("prestoclient_query",                    void_p, [void_p, char_p, char_p, _NATIVE_CALLBACK,
+                                                                   _NATIVE_CALLBACK, void_p]),
+                ("prestoclient_getstatus",                uint,   [void_p]),
+                ("prestoclient_getlastserverstate",       char_p, [void_p]),
+                ("prestoclient_getcolumncount",           uint,   [void_p]),
+                ("prestoclient_getcolumnname",            char_p, [void_p, uint]),
+                ("prestoclient_getcolumnservertype",      char_p, [void_p, uint]),
+                ("prestoclient_cancelquery",              None,   [void_p]),
+                ("prestoclient_getlastservererror",       char_p, [void_p]),
+                ("prestoclient_getlastservermessage",     char_p, [void_p]),
+                ("prestoclient_getlastclienterror",       char_p, [void_p]),
+                ("prestoclient_getlastcurlerror",         char_p, [void_p]),
+                ("prestoclient_batch_new",                void_p, []),
+                ("prestoclient_batch_delete",             None,   [void_p]),
+                ("prestoclient_batch_clear",              None,   [void_p]),
+                ("prestoclient_batch_getrowcount",        uint,   [void_p]),
+                ("prestoclient_batch_getcolumncount",     uint,   [void_p]),
+                ("prestoclient_batch_getcolumntype",      uint,   [void_p, uint]),
+                ("prestoclient_batch_getvalues",          void_p, [void_p, uint]),
+                ("prestoclient_batch_getoffsets",         void_p, [void_p, uint]),
+                ("prestoclient_batch_getnulls",           void_p, [void_p, uint]),
+                ("prestoclient_batch_getnullcount",       uint,   [void_p, uint])]:
+            getattr(library, function).restype = restype
+            getattr(library, function).argtypes = argtypes
+
+        _nativelibrary = library
+        break
+
+    return _nativelibrary
+
+
+def _nativestring(in_value):
+    """ Return a string of the C library as unicode, like the json decoder does. The C library does not translate
+    json escape sequences.
+
+    """
+    return json.loads('"' + in_value + '"')
+
+
+class _NativeQuery:
+    """ Runs one query with the C library in a background thread. The library collects the rows of every response
+    per column in a batch. After every response the columns are copied to Python at once and the rows are handed
+    to the thread reading the query through a queue. The queue is short so memory use stays limited to a few pages.
+
+    """
+
+    __maximumpages = 2                          #: Number of pages that may wait in the queue
+
+    __numpy = None                              #: Numpy module when pages are handed over as typed columns
+
+    def __init__(self, in_library, in_server, in_port, in_catalog, in_user, in_timezone, in_language,
+                 in_sql_statement, in_schema):
+        self.__library = in_library
+        self.__arguments = (in_server, in_port, in_catalog, in_user, in_timezone, in_language,
+                            in_sql_statement, in_schema)
+        self.__queue = Queue.Queue(self.__maximumpages)
+        self.__started = threading.Event()
+        self.__resultlock = threading.Lock()
+        self.__result = None
+        self.__posted = False
+        self.__cancelled = False
+        self.__nested = []
+
+        # Keep references to the callbacks as long as the library may call them
+        self.__progresscallback = _NATIVE_CALLBACK(self.__progress)
+        self.__describecallback = _NATIVE_CALLBACK(self.__describe)
+        self.__writecallback = ctypes.cast(in_library.prestoclient_batch_writecallback, _NATIVE_CALLBACK)
+
+        self.status = "NONE"                    #: Status of the query, like PrestoClient.getstatus()
+        self.state = ""                         #: State reported by the Presto server
+        self.error = ""                         #: Error message, empty string if there is no error
+        self.columns = {}                       #: Column information, list of dictionaries with name and type
+
+    def start(self):
+        """ Start the query and wait until the server accepted it. Returns False if it didn't. """
+        thread = threading.Thread(target=self.__run)
+        thread.daemon = True
+        thread.start()
+
+        self.__started.wait()
+
+        return self.__posted
+
+    def nextpage(self):
+        """ Wait for the next page of data. Returns a list of rows, or None when the query has finished. """
+        return self.__queue.get()
+
+    def setnumpy(self, in_numpy):
+        """ Hand over the next pages as a tuple of columns, each a tuple of a numpy array of values and a boolean
+        array of nulls or None, instead of a list of rows.
+
+        """
+        self.__numpy = in_numpy
+
+    def cancel(self):
+        """ Ask the C library to cancel the query. May be called from any thread. """
+        with self.__resultlock:
+            self.__cancelled = True
+
+            if self.__result:
+                self.__library.prestoclient_cancelquery(self.__result)
+
+    def __run(self):
+        library = self.__library
+        server, port, catalog, user, timezone, language, sql, schema = self.__arguments
+
+        try:
+            client = library.prestoclient_init(server, ctypes.byref(ctypes.c_uint(port)), catalog, user, None,
+                                               timezone or None, language or None)
+
+            if not client:
+                self.status = "FAILED"
+                self.error = "Could not initialize the C library"
+                return
+
+            library.prestoclient_setprogresscallback(client, self.__progresscallback)
+            batch = library.prestoclient_batch_new()
+
+            result = library.prestoclient_query(client, sql, schema, self.__writecallback, self.__describecallback,
+                                                batch)
+
+            # A cancelled query may leave rows that were received after the last response was handled
+            self.__sendbatch(batch)
+
+            if result:
+                self.status = _NATIVE_STATUS[library.prestoclient_getstatus(result)]
+                self.state = library.prestoclient_getlastserverstate(result) or self.state
+                # Like the pure Python client only the message of a server error, without the exception type
+                servermessage = library.prestoclient_getlastservermessage(result)
+                self.error = (servermessage and _nativestring(servermessage) or
+                              library.prestoclient_getlastservererror(result) or
+                              library.prestoclient_getlastclienterror(result) or
+                              library.prestoclient_getlastcurlerror(result) or "")
+
+                # The library fails a cancelled query. Like the pure Python client report it without an error
+                if self.__cancelled and self.status == "FAILED" and not library.prestoclient_getlastservererror(result):
+                    self.status = "NONE"
+                    self.error = ""
+            else:
+                self.status = "FAILED"
+                self.error = "Could not start query"
+
+            with self.__resultlock:
+                self.__result = None
+
+            library.prestoclient_batch_delete(batch)
+            library.prestoclient_close(client)
+
+        finally:
+            self.__started.set()
+            self.__queue.put(None)
+
+    def __progress(self, in_batch, in_result):
+        """ Called by the C library after every response """
+        with self.__resultlock:
+            self.__result = in_result
+
+        self.__posted = True
+        self.state = self.__library.prestoclient_getlastserverstate(in_result) or ""
+        self.status = "RUNNING"
+        self.__sendbatch(in_batch)
+        self.__started.set()
+
+    def __describe(self, in_batch, in_result):
+        """ Called by the C library when the column information is available """
+        library = self.__library
+
+        # The name and type as sent by the server. Unlike the pure Python client there is no typeSignature
+        self.columns = [{"name": _nativestring(library.prestoclient_getcolumnname(in_result, i)),
+                         "type": _nativestring(library.prestoclient_getcolumnservertype(in_result, i))}
+                        for i in range(library.prestoclient_getcolumncount(in_result))]
+
+        # The library keeps array, map and row values as json text
+        self.__nested = [column["type"].startswith(("array(", "map(", "row(")) for column in self.columns]
+
+    def __sendbatch(self, in_batch):
+        """ Copy the rows in the batch to a list of rows, put them in the queue and clear the batch """
+        library = self.__library
+        rowcount = library.prestoclient_batch_getrowcount(in_batch)
+
+        if rowcount == 0:
+            return
+
+        if self.__numpy:
+            page = tuple(self.__getnumpycolumn(in_batch, i, rowcount)
+                         for i in range(library.prestoclient_batch_getcolumncount(in_batch)))
+        else:
+            columns = [self.__getcolumn(in_batch, i, rowcount)
+                       for i in range(library.prestoclient_batch_getcolumncount(in_batch))]
+            page = map(list, izip(*columns))
+
+        library.prestoclient_batch_clear(in_batch)
+
+        self.__queue.put(page)
+
+    def __getcolumn(self, in_batch, in_column, in_rowcount):
+        """ Return the values of a column in the batch as a list """
+        library = self.__library
+        columntype = library.prestoclient_batch_getcolumntype(in_batch, in_column)
+        values = library.prestoclient_batch_getvalues(in_batch, in_column)
+
+        if columntype == _NATIVE_BATCH_BIGINT:
+            data = (ctypes.c_longlong * in_rowcount).from_address(values)[:]
+        elif columntype == _NATIVE_BATCH_DOUBLE:
+            data = (ctypes.c_double * in_rowcount).from_address(values)[:]
+        elif columntype == _NATIVE_BATCH_BOOLEAN:
+            data = map(bool, bytearray(ctypes.string_at(values, in_rowcount)))
+        else:
+            data = self.__gettext(in_batch, in_column, in_rowcount, values)
+
+        if library.prestoclient_batch_getnullcount(in_batch, in_column) > 0:
+            nulls = bytearray(ctypes.string_at(library.prestoclient_batch_getnulls(in_batch, in_column), in_rowcount))
+            data = [None if isnull else value for value, isnull in izip(data, nulls)]
+
+        return data
+
+    def __getnumpycolumn(self, in_batch, in_column, in_rowcount):
+        """ Return the values of a column in the batch as a numpy array and the nulls as a boolean array or None """
+        library = self.__library
+        numpy = self.__numpy
+        columntype = library.prestoclient_batch_getcolumntype(in_batch, in_column)
+        values = library.prestoclient_batch_getvalues(in_batch, in_column)
+
+        if columntype == _NATIVE_BATCH_BIGINT:
+            data = numpy.frombuffer(ctypes.string_at(values, in_rowcount * 8), numpy.int64)
+        elif columntype == _NATIVE_BATCH_DOUBLE:
+            data = numpy.frombuffer(ctypes.string_at(values, in_rowcount * 8), numpy.float64)
+        elif columntype == _NATIVE_BATCH_BOOLEAN:
+            data = numpy.frombuffer(ctypes.string_at(values, in_rowcount), numpy.bool_)
+        else:
+            data = numpy.array(self.__gettext(in_batch, in_column, in_rowcount, values), dtype=object)
+
+        nulls = None
+
+        if library.prestoclient_batch_getnullcount(in_batch, in_column) > 0:
+            nulls = numpy.frombuffer(ctypes.string_at(library.prestoclient_batch_getnulls(in_batch, in_column),
+                                                      in_rowcount), numpy.bool_)
+
+        return data, nulls
+
+    def __gettext(self, in_batch, in_column, in_rowcount, in_values):
+        """ Return the values of a text column in the batch as a list of unicode strings """
+        offsets = (ctypes.c_uint * (in_rowcount + 1)).from_address(
+            self.__library.prestoclient_batch_getoffsets(in_batch, in_column))
+        text = ctypes.string_at(in_values, offsets[in_rowcount])
+
+        # Every value is followed by a zero byte. Split on them unless a value contains one itself
+        data = text.decode("utf-8").split(u"\x00")
+        data.pop()
+
+        if len(data) != in_rowcount:
+            data = [text[offsets[i]:offsets[i + 1] - 1].decode("utf-8") for i in range(in_rowcount)]
+
+        # Decode nested values like the pure Python client does. Nulls are empty and replaced by the caller
+        if in_column < len(self.__nested) and self.__nested[in_column]:
+            data = [value and json.loads(value) for value in data]
+
+        return data
+
+
+# Numpy types used by getnumpy() for Presto types, all other types are kept as objects
+_NUMPY_TYPES = {"bigint": "int64", "integer": "int64", "smallint": "int64", "tinyint": "int64",
+                "double": "float64", "real": "float64", "boolean": "bool",
+                "date": "datetime64[D]", "timestamp": "datetime64[ms]"}
+
+
+def _numpypage(in_numpy, in_rows, in_columncount):
+    """ Split a page of rows into columns, a list of tuples of an object array of values and None for the nulls """
+    array = in_numpy.array(in_rows, dtype=object)
+
+    # Values that are lists themselves (arrays and maps) give the array more dimensions
+    if array.ndim != 2 or array.shape[1] != in_columncount:
+        array = in_numpy.empty((len(in_rows), in_columncount), dtype=object)
+
+        for i, row in enumerate(in_rows):
+            for j in range(in_columncount):
+                array[i, j] = row[j]
+
+    return [(array[:, j], None) for j in range(in_columncount)]
+
+
+def _pandascolumn(in_pandas, in_numpy, in_array):
+    """ Convert a masked array returned by getnumpy() to a pandas column with NaN, NaT or None for null values """
+    nulls = in_numpy.ma.getmaskarray(in_array)
+    values = in_array.data
+
+    if not nulls.any():
+        return values
+
+    if values.dtype.kind == "i":
+        if hasattr(in_pandas, "arrays") and hasattr(in_pandas.arrays, "IntegerArray"):
+            return in_pandas.arrays.IntegerArray(values, nulls)
+
+        return in_array.astype("float64").filled(in_numpy.nan)
+
+    if values.dtype.kind == "b" and hasattr(in_pandas, "arrays") and hasattr(in_pandas.arrays, "BooleanArray"):
+        return in_pandas.arrays.BooleanArray(values, nulls)
+
+    if values.dtype.kind == "f":
+        return in_array.filled(in_numpy.nan)
+
+    if values.dtype.kind == "M":
+        return in_array.filled(in_numpy.datetime64("NaT"))
+
+    values = values.astype(object)
+    values[nulls] = None
+
+    return values
+
+
+class _NumpyColumn:
+    """ Collects the values of one column page by page in a preallocated numpy array of the type of the column,
+    with a boolean array marking the null values. Both double in size when they are full.
+
+    """
+
+    __initialsize = 1024                        #: Number of values reserved for the first page
+
+    def __init__(self, in_numpy, in_type):
+        self.__numpy = in_numpy
+        self.__dtype = in_numpy.dtype(_NUMPY_TYPES.get(in_type, "object"))
+        self.__values = in_numpy.empty(self.__initialsize, self.__dtype)
+        self.__nulls = in_numpy.zeros(self.__initialsize, bool)
+        self.__size = 0
+
+    def add(self, in_values, in_nulls):
+        """ Add the values of a page, a numpy array or list. in_nulls is a boolean array or None, when None the
+        values that are None are null.
+
+        """
+        numpy = self.__numpy
+        values = in_values if isinstance(in_values, numpy.ndarray) else numpy.array(in_values, dtype=object)
+        nulls = in_nulls
+
+        if nulls is None and values.dtype == object:
+            nulls = numpy.equal(values, None)
+
+        # Replace nulls by a value the conversion accepts, they are masked anyway
+        if nulls is not None and values.dtype == object and self.__dtype != object and nulls.any():
+            values = values.copy()
+            values[nulls] = "NaT" if self.__dtype.kind == "M" else 0
+
+        if values.dtype != self.__dtype:
+            values = values.astype(self.__dtype)
+
+        count = len(values)
+
+        if self.__size + count > len(self.__values):
+            capacity = len(self.__values)
+
+            while capacity < self.__size + count:
+                capacity *= 2
+
+            self.__values = self.__grow(self.__values, capacity)
+            self.__nulls = self.__grow(self.__nulls, capacity)
+
+        self.__values[self.__size:self.__size + count] = values
+        self.__nulls[self.__size:self.__size + count] = False if nulls is None else nulls
+        self.__size += count
+
+    def getarray(self):
+        """ Return the values as a masked array, the buffers are shrunk to the number of values """
+        self.__values = self.__grow(self.__values, self.__size)
+        self.__nulls = self.__grow(self.__nulls, self.__size)
+
+        return self.__numpy.ma.masked_array(self.__values, mask=self.__nulls)
+
+    def __grow(self, in_array, in_size):
+        array = self.__numpy.empty(in_size, in_array.dtype)
+        count = min(self.__size, in_size)
+        array[:count] = in_array[:count]
+        return array
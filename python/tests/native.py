@@ -0,0 +1,113 @@
+"""
+Runs the same queries against prestomockserver with the pure Python client and with the C library and checks that
+both return the same rows, columns, status and error. Covers the types the C library converts itself and nested
+array and map values, which it returns as json text.
+
+Usage: python native.py <path of prestomockserver> <path of libprestoclient>
+
+"""
+import os
+import socket
+import subprocess
+import sys
+import time
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+
+import prestoclient
+
+
+def freeport():
+    """ Return a tcp port nobody listens on """
+    listener = socket.socket()
+    listener.bind(("127.0.0.1", 0))
+    port = listener.getsockname()[1]
+    listener.close()
+    return port
+
+
+def startserver(in_server, in_port, in_arguments):
+    """ Start the mock server and wait until it accepts connections """
+    server = subprocess.Popen([in_server, "--port=%d" % in_port] + in_arguments, stdout=open(os.devnull, "w"))
+
+    for i in range(100):
+        try:
+            socket.create_connection(("127.0.0.1", in_port), 1).close()
+            return server
+        except socket.error:
+            time.sleep(0.05)
+
+    server.kill()
+    raise RuntimeError("prestomockserver did not start")
+
+
+def runquery(in_port, in_native, in_sql, in_cancel=False):
+    """ Return columns, rows, status and error of a query """
+    client = prestoclient.PrestoClient("127.0.0.1", in_port, in_native=in_native)
+
+    if in_native and not client.isnative():
+        raise RuntimeError("Can't load the C library, set PRESTOCLIENT_LIBRARY")
+
+    if client.startquery(in_sql):
+        if in_cancel:
+            client.cancelquery()
+
+        client.waituntilfinished()
+
+    columns = [(column["name"], column["type"]) for column in client.getcolumns()]
+    answer = (columns, client.getdata(), client.getstatus(), client.getlasterrormessage())
+    client.close()
+
+    return answer
+
+
+def compare(in_name, in_pure, in_native):
+    """ Print the first difference, return True if there is none """
+    for label, pure, native in zip(["columns", "rows", "status", "error"], in_pure, in_native):
+        if label == "rows":
+            for i, (purerow, nativerow) in enumerate(zip(pure, native)):
+                if purerow != nativerow:
+                    print "%s: row %d differs\n  pure:   %r\n  native: %r" % (in_name, i, purerow, nativerow)
+                    return False
+
+        if pure != native:
+            print "%s: %s differs\n  pure:   %r\n  native: %r" % (in_name, label, pure, native)
+            return False
+
+    print "%s: %d rows identical, status %s" % (in_name, len(in_pure[1]), in_pure[2])
+    return True
+
+
+def main():
+    if len(sys.argv) != 3:
+        print __doc__
+        return 2
+
+    os.environ["PRESTOCLIENT_LIBRARY"] = sys.argv[2]
+
+    tests = [("nested", ["--rows=2500", "--page-rows=700", "--columns=8", "--null-percent=15", "--escapes",
+                         "--types=integer,real,array,map,bigint,boolean,varchar,date"], False),
+             ("plain", ["--rows=1000", "--columns=4", "--types=bigint,double,varchar,timestamp"], False),
+             ("failed", ["--rows=1000", "--page-rows=200", "--fail-after=2"], False),
+             ("cancelled", ["--rows=1000", "--latency=200", "--queued-polls=2"], True)]
+    failures = 0
+
+    for name, arguments, cancel in tests:
+        port = freeport()
+        server = startserver(sys.argv[1], port, arguments)
+
+        try:
+            pure = runquery(port, False, "select * from mock", cancel)
+            native = runquery(port, True, "select * from mock", cancel)
+        finally:
+            server.kill()
+            server.wait()
+
+        if not compare(name, pure, native):
+            failures += 1
+
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())